@@ -0,0 +1,79 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_MIN_BLOCK 65536
+#define ARENA_MAX_BLOCK (1 << 20)
+#define ARENA_ALIGN 8
+
+struct ArenaBlock_ {
+  struct ArenaBlock_ *next;
+  size_t size;
+  _Alignas(ARENA_ALIGN) char data[];
+};
+
+typedef struct ArenaBlock_ ArenaBlock;
+
+// Blocks double up to ARENA_MAX_BLOCK; anything larger gets a block of its own
+static void addBlock(Arena *arena, size_t size) {
+  size_t blockSize = (arena->blocks == NULL) ? ARENA_MIN_BLOCK : arena->blocks->size * 2;
+  ArenaBlock *block;
+
+  if (blockSize > ARENA_MAX_BLOCK)
+    blockSize = ARENA_MAX_BLOCK;
+  if (blockSize < size)
+    blockSize = size;
+  block = (ArenaBlock*) malloc(sizeof(ArenaBlock) + blockSize);
+  block->next = arena->blocks;
+  block->size = blockSize;
+  arena->blocks = block;
+  arena->next = block->data;
+  arena->end = block->data + blockSize;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+  void *p;
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+  if ((size_t) (arena->end - arena->next) < size)
+    addBlock(arena, size);
+  p = arena->next;
+  arena->next += size;
+  return p;
+}
+
+void resetArena(Arena *arena) {
+  ArenaBlock *largest = arena->blocks;
+  ArenaBlock *block;
+
+  if (largest == NULL)
+    return;
+  for (block = largest->next; block != NULL; block = block->next)
+    if (block->size > largest->size)
+      largest = block;
+  while (arena->blocks != NULL) {
+    block = arena->blocks;
+    arena->blocks = block->next;
+    if (block != largest)
+      free(block);
+  }
+  largest->next = NULL;
+  arena->blocks = largest;
+  arena->next = largest->data;
+  arena->end = largest->data + largest->size;
+}
+
+void freeArena(Arena *arena) {
+  while (arena->blocks != NULL) {
+    ArenaBlock *block = arena->blocks;
+    arena->blocks = block->next;
+    free(block);
+  }
+  memset(arena, 0, sizeof(Arena));
+}
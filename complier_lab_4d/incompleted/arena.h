@@ -0,0 +1,31 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+// Memory handed out by an arena is never freed piece by piece; it all goes
+// at once when the arena is reset.
+
+struct ArenaBlock_;
+
+struct Arena_ {
+  struct ArenaBlock_ *blocks;   // the newest, and largest, first
+  char *next;                   // free space in the newest block
+  char *end;
+};
+
+typedef struct Arena_ Arena;
+
+// A zeroed Arena is empty and ready to use
+void *arenaAlloc(Arena *arena, size_t size);
+// Keeps the largest block for the next compilation
+void resetArena(Arena *arena);
+void freeArena(Arena *arena);
+
+#endif
@@ -0,0 +1,68 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "compiler.h"
+
+#define INITIAL_POOL_SIZE 256
+
+// Bumps count, growing the pool by doubling; slot 0 is kept for NO_NODE
+static uint32_t allocNode(void **pool, uint32_t *count, uint32_t *capacity, size_t size) {
+  if (*count == 0)
+    *count = 1;
+  if (*count >= *capacity) {
+    *capacity = (*capacity == 0) ? INITIAL_POOL_SIZE : *capacity * 2;
+    *pool = realloc(*pool, *capacity * size);
+  }
+  memset((char*) *pool + *count * size, 0, size);
+  return (*count)++;
+}
+
+NodeId newExpr(KplCompiler *compiler, ExprKind kind, int offset, Type *type) {
+  NodeId id = allocNode((void**) &compiler->ast.exprs, &compiler->ast.exprCount, &compiler->ast.exprCapacity, sizeof(ExprNode));
+  compiler->ast.exprs[id].kind = kind;
+  compiler->ast.exprs[id].offset = offset;
+  compiler->ast.exprs[id].type = type;
+  return id;
+}
+
+NodeId newStmt(KplCompiler *compiler, StmtKind kind, int offset) {
+  NodeId id = allocNode((void**) &compiler->ast.stmts, &compiler->ast.stmtCount, &compiler->ast.stmtCapacity, sizeof(StmtNode));
+  compiler->ast.stmts[id].kind = kind;
+  compiler->ast.stmts[id].offset = offset;
+  return id;
+}
+
+void newRoutine(KplCompiler *compiler, Object *owner, NodeId body) {
+  NodeId id = allocNode((void**) &compiler->ast.routines, &compiler->ast.routineCount, &compiler->ast.routineCapacity, sizeof(RoutineNode));
+  compiler->ast.routines[id].owner = owner;
+  compiler->ast.routines[id].body = body;
+}
+
+ExprNode *exprNode(KplCompiler *compiler, NodeId id) {
+  return &compiler->ast.exprs[id];
+}
+
+StmtNode *stmtNode(KplCompiler *compiler, NodeId id) {
+  return &compiler->ast.stmts[id];
+}
+
+// NO_NODE, left by a syntax error, has an unknown type
+Type *exprType(KplCompiler *compiler, NodeId id) {
+  if (id == NO_NODE)
+    return NULL;
+  return compiler->ast.exprs[id].type;
+}
+
+// The whole tree goes at once; nothing inside a pool is freed on its own
+void resetAst(KplCompiler *compiler) {
+  free(compiler->ast.exprs);
+  free(compiler->ast.stmts);
+  free(compiler->ast.routines);
+  memset(&compiler->ast, 0, sizeof(Ast));
+}
@@ -0,0 +1,100 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <stdint.h>
+#include "symtab.h"
+
+// Nodes are named by their index in the pool of their kind; 0 is no node
+typedef uint32_t NodeId;
+
+#define NO_NODE 0
+
+typedef enum {
+  EXP_NUMBER,       // value
+  EXP_CHAR,         // value
+  EXP_CONSTANT,     // object
+  EXP_VARIABLE,     // object, depth, frameOffset
+  EXP_PARAMETER,    // object, depth, frameOffset
+  EXP_FUNCTION,     // object, depth, frameOffset: the function's result, as an lvalue
+  EXP_CALL,         // object, left: first argument
+  EXP_INDEX,        // left: array, right: index
+  EXP_NEGATE,       // left
+  EXP_ADD, EXP_SUB, EXP_MUL, EXP_DIV,
+  EXP_EQ, EXP_NEQ, EXP_LT, EXP_LE, EXP_GT, EXP_GE
+} ExprKind;
+
+typedef struct {
+  uint8_t kind;
+  int depth;        // static links from the current frame to the one holding the storage
+  int offset;
+  Type *type;       // NULL for comparisons
+  union {
+    int value;
+    Object *object;
+  };
+  NodeId left;
+  NodeId right;
+  NodeId next;      // next argument of a call
+  int frameOffset;  // words into that frame
+} ExprNode;
+
+typedef enum {
+  ST_ASSIGN,        // target := expr
+  ST_CALL,          // object, expr: first argument
+  ST_GROUP,         // body
+  ST_IF,            // expr: condition, body, elseBody
+  ST_WHILE,         // expr: condition, body
+  ST_FOR            // target := expr TO limit DO body; object: target's variable
+} StmtKind;
+
+typedef struct {
+  uint8_t kind;
+  int offset;
+  Object *object;
+  NodeId target;
+  NodeId expr;
+  NodeId limit;
+  NodeId body;
+  NodeId elseBody;
+  NodeId next;      // next statement of the enclosing list
+} StmtNode;
+
+// The statement list of one program, function or procedure body
+typedef struct {
+  Object *owner;
+  NodeId body;
+} RoutineNode;
+
+// Each kind of node lives in its own growing pool. Pools move when they
+// grow, so node pointers must not be held across the creation of a node.
+struct Ast_ {
+  ExprNode *exprs;
+  uint32_t exprCount;
+  uint32_t exprCapacity;
+  StmtNode *stmts;
+  uint32_t stmtCount;
+  uint32_t stmtCapacity;
+  RoutineNode *routines;
+  uint32_t routineCount;
+  uint32_t routineCapacity;
+};
+
+typedef struct Ast_ Ast;
+
+NodeId newExpr(KplCompiler *compiler, ExprKind kind, int offset, Type *type);
+NodeId newStmt(KplCompiler *compiler, StmtKind kind, int offset);
+void newRoutine(KplCompiler *compiler, Object *owner, NodeId body);
+
+ExprNode *exprNode(KplCompiler *compiler, NodeId id);
+StmtNode *stmtNode(KplCompiler *compiler, NodeId id);
+Type *exprType(KplCompiler *compiler, NodeId id);
+
+void resetAst(KplCompiler *compiler);
+
+#endif
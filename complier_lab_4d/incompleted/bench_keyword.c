@@ -0,0 +1,93 @@
+/* Keyword lookup microbenchmark
+ *
+ * Compares checkKeyword() with the linear keyword scan it replaced over an
+ * identifier-heavy corpus and reports identifiers per second for both.
+ *
+ *   make bench_keyword && ./bench_keyword
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "token.h"
+#include "timer.h"
+
+#define CORPUS_SIZE 65536
+#define ROUNDS 200
+#define MAX_WORD_LEN 15
+
+char *linearKeywords[KEYWORDS_COUNT] = {
+  "PROGRAM", "CONST", "TYPE", "VAR", "INTEGER", "CHAR", "ARRAY", "OF", "FUNCTION", "PROCEDURE",
+  "BEGIN", "END", "CALL", "IF", "THEN", "ELSE", "WHILE", "DO", "FOR", "TO"
+};
+
+TokenType linearTypes[KEYWORDS_COUNT] = {
+  KW_PROGRAM, KW_CONST, KW_TYPE, KW_VAR, KW_INTEGER, KW_CHAR, KW_ARRAY, KW_OF, KW_FUNCTION, KW_PROCEDURE,
+  KW_BEGIN, KW_END, KW_CALL, KW_IF, KW_THEN, KW_ELSE, KW_WHILE, KW_DO, KW_FOR, KW_TO
+};
+
+int linearKeywordEq(char *kw, char *string) {
+  while ((*kw != '\0') && (*string != '\0')) {
+    if (*kw != *string) break;
+    kw ++; string ++;
+  }
+  return ((*kw == '\0') && (*string == '\0'));
+}
+
+TokenType linearCheckKeyword(char *string) {
+  int i;
+  for (i = 0; i < KEYWORDS_COUNT; i++)
+    if (linearKeywordEq(linearKeywords[i], string))
+      return linearTypes[i];
+  return TK_NONE;
+}
+
+// One word in four is a keyword, the rest are identifiers of 1..15 characters
+void makeCorpus(char corpus[][MAX_WORD_LEN + 1]) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  int i, j, length;
+
+  srand(3323);
+  for (i = 0; i < CORPUS_SIZE; i++) {
+    if (rand() % 4 == 0) {
+      strcpy(corpus[i], linearKeywords[rand() % KEYWORDS_COUNT]);
+      continue;
+    }
+    length = 1 + rand() % MAX_WORD_LEN;
+    corpus[i][0] = alphabet[rand() % 26];
+    for (j = 1; j < length; j++)
+      corpus[i][j] = alphabet[rand() % 36];
+    corpus[i][length] = '\0';
+  }
+}
+
+double run(TokenType (*check)(char *), char corpus[][MAX_WORD_LEN + 1], long *keywordCount) {
+  double start = now();
+  long count = 0;
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < CORPUS_SIZE; i++)
+      if (check(corpus[i]) != TK_NONE)
+        count ++;
+  *keywordCount = count;
+  return (double) ROUNDS * CORPUS_SIZE / (now() - start);
+}
+
+int main(void) {
+  static char corpus[CORPUS_SIZE][MAX_WORD_LEN + 1];
+  long linearHits, hashHits;
+  double linearRate, hashRate;
+
+  makeCorpus(corpus);
+  linearRate = run(linearCheckKeyword, corpus, &linearHits);
+  hashRate = run(checkKeyword, corpus, &hashHits);
+
+  if (linearHits != hashHits) {
+    printf("keyword counts differ: linear %ld, hash %ld\n", linearHits, hashHits);
+    return 1;
+  }
+  printf("linear scan:  %12.0f identifiers/s\n", linearRate);
+  printf("perfect hash: %12.0f identifiers/s (%.1fx)\n", hashRate, hashRate / linearRate);
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* Scanner throughput benchmark
+ *
+ * Runs getToken() over synthetic KPL corpora (identifier-, comment-,
+ * number- and symbol-heavy) and reports MB/s, tokens/s and heap
+ * allocations per token. Sizes default to 1M, 100M and 1G; any sizes
+ * given on the command line replace them.
+ *
+ *   make bench_scanner && ./bench_scanner [size...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reader.h"
+#include "scanner.h"
+#include "intern.h"
+#include "compiler.h"
+#include "timer.h"
+
+// Small corpora are scanned repeatedly so that every run covers this much text
+#define MIN_BYTES_SCANNED (256L << 20)
+
+typedef void (*Generator)(char *text, long size);
+
+/******************************************************************/
+
+// The Makefile links this program with --wrap for the allocator entry points
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+long allocationCount = 0;
+
+void *__wrap_malloc(size_t size) {
+  allocationCount ++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  allocationCount ++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  allocationCount ++;
+  return __real_realloc(ptr, size);
+}
+
+/******************************************************************/
+
+// Appends words from pick() until the text is full, then blanks out the tail
+void fill(char *text, long size, int (*pick)(char *word)) {
+  char word[128];
+  long length = 0;
+  int n;
+
+  while ((n = pick(word)) < size - length) {
+    memcpy(text + length, word, n);
+    length += n;
+  }
+  memset(text + length, ' ', size - length);
+}
+
+int pickIdent(char *word) {
+  static const char *keywords[] = {"BEGIN", "END", "IF", "THEN", "VAR", "CALL", "WHILE", "DO"};
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  unsigned hash;
+  int n, i;
+
+  if (rand() % 5 == 0)
+    n = sprintf(word, "%s", keywords[rand() % 8]);
+  else {
+    // A few thousand distinct names, as in a large program
+    hash = (1 + rand() % 4096) * 2654435761u;
+    n = 1 + hash % 12;
+    word[0] = alphabet[(hash >> 8) % 52];
+    for (i = 1; i < n; i++) {
+      hash = hash * 1103515245u + 12345u;
+      word[i] = alphabet[(hash >> 16) % 62];
+    }
+  }
+  word[n++] = (rand() % 8 == 0) ? '\n' : ' ';
+  return n;
+}
+
+int pickComment(char *word) {
+  static const char *lines[] = {
+    "(* Computes the sum of the first N elements of the array A. *)\n",
+    "(* The loop below runs from 1 to N; (. and .) are plain text here *)\n",
+    "  (* ************************************************ *)\n",
+    "X := X + 1; (* count it *)\n"
+  };
+  return sprintf(word, "%s", lines[rand() % 4]);
+}
+
+int pickNumber(char *word) {
+  return sprintf(word, "%d%s", rand() % 100000, (rand() % 10 == 0) ? ",\n" : ", ");
+}
+
+int pickSymbol(char *word) {
+  static const char *symbols[] = {
+    ":=", "<=", ">=", "!=", "(", ")", "(.", ".)", "+", "-", "*", "/", ";", ",", ".", ":", "=", "<", ">"
+  };
+  const char *symbol = symbols[rand() % 19];
+  int spaced = (rand() % 4 == 0);
+
+  // "(" right before "*" would open a comment, so it is always spaced
+  if (strcmp(symbol, "(") == 0)
+    spaced = 1;
+  return sprintf(word, "%s%s", symbol, spaced ? " " : "");
+}
+
+void makeIdentHeavy(char *text, long size) { fill(text, size, pickIdent); }
+void makeCommentHeavy(char *text, long size) { fill(text, size, pickComment); }
+void makeNumberHeavy(char *text, long size) { fill(text, size, pickNumber); }
+void makeSymbolHeavy(char *text, long size) { fill(text, size, pickSymbol); }
+
+/******************************************************************/
+
+long parseSize(const char *arg) {
+  char *end;
+  long size = strtol(arg, &end, 10);
+
+  switch (*end) {
+  case 'k': case 'K': size <<= 10; break;
+  case 'm': case 'M': size <<= 20; break;
+  case 'g': case 'G': size <<= 30; break;
+  }
+  return size;
+}
+
+void bench(KplCompiler *compiler, const char *name, Generator generate, const char *label, long size) {
+  char *text = (char*) malloc(size + 1);
+  long rounds = (size < MIN_BYTES_SCANNED) ? MIN_BYTES_SCANNED / size : 1;
+  long tokens = 0;
+  long allocations;
+  double start, elapsed;
+  long round;
+
+  if (text == NULL) {
+    printf("%-8s %5s  out of memory\n", name, label);
+    return;
+  }
+  srand(3323);
+  generate(text, size);
+  text[size] = '\0';
+
+  allocations = allocationCount;
+  start = now();
+  for (round = 0; round < rounds; round++) {
+    openInputView(compiler, text, size, 0);
+    while (getToken(compiler)->tokenType != TK_EOF)
+      tokens ++;
+    closeInputStream(compiler);
+    freeInternTable(&compiler->internTable);
+  }
+  elapsed = now() - start;
+  allocations = allocationCount - allocations;
+
+  printf("%-8s %5s %10.1f MB/s %12.0f tokens/s %10.4f allocs/token\n",
+         name, label, (double) size * rounds / elapsed / (1 << 20),
+         tokens / elapsed, (double) allocations / tokens);
+  free(text);
+}
+
+int main(int argc, char *argv[]) {
+  static const char *defaultSizes[] = {"1M", "100M", "1G"};
+  const char **sizes = defaultSizes;
+  KplCompiler *compiler = createCompiler();
+  int sizeCount = 3;
+  int i;
+
+  if (argc > 1) {
+    sizes = (const char**) argv + 1;
+    sizeCount = argc - 1;
+  }
+  for (i = 0; i < sizeCount; i++) {
+    long size = parseSize(sizes[i]);
+    if (size <= 0) {
+      printf("bad size: %s\n", sizes[i]);
+      freeCompiler(compiler);
+      return 1;
+    }
+    bench(compiler, "ident", makeIdentHeavy, sizes[i], size);
+    bench(compiler, "comment", makeCommentHeavy, sizes[i], size);
+    bench(compiler, "number", makeNumberHeavy, sizes[i], size);
+    bench(compiler, "symbol", makeSymbolHeavy, sizes[i], size);
+  }
+  freeCompiler(compiler);
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include "reader.h"
+#include "scanner.h"
+#include "compiler.h"
+
+KplCompiler *createCompiler(void) {
+  KplCompiler *compiler = (KplCompiler*) calloc(1, sizeof(KplCompiler));
+
+  compiler->lexThreads = 1;
+  compiler->output = stdout;
+  compiler->lastErrorOffset = -1;
+  return compiler;
+}
+
+void freeCompiler(KplCompiler *compiler) {
+  if (compiler->inputBuffer != NULL)
+    closeInputStream(compiler);
+  freeScanner(compiler);
+  freeInternTable(&compiler->internTable);
+  freeArena(&compiler->arena);
+  free(compiler);
+}
+
+void copyOptions(KplCompiler *compiler, KplCompiler *options) {
+  compiler->pretokenize = options->pretokenize;
+  compiler->lexThreads = options->lexThreads;
+  compiler->tokenCacheDir = options->tokenCacheDir;
+  compiler->dumpFrames = options->dumpFrames;
+}
@@ -0,0 +1,77 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __COMPILER_H__
+#define __COMPILER_H__
+
+#include <stdio.h>
+#include "token.h"
+#include "intern.h"
+#include "tokenstream.h"
+#include "symtab.h"
+#include "ast.h"
+#include "arena.h"
+
+// The parser holds at most currentToken and lookAhead while the scanner
+// builds the next token, so a ring slot is dead by the time it is reused
+#define TOKEN_RING_SIZE 4
+
+enum InputKind {
+  INPUT_MAPPED,
+  INPUT_OWNED,
+  INPUT_VIEW
+};
+
+// Everything one compilation touches. Compilations share no other state,
+// so each thread can drive its own KplCompiler.
+struct KplCompiler_ {
+  // Options, set before compiling
+  int pretokenize;            // lex the whole input before parsing
+  int lexThreads;
+  char *tokenCacheDir;        // reuse token streams saved here; implies pretokenize
+  int dumpFrames;             // follow the symbol table dump with frame layouts
+
+  // Reader
+  const char *inputBuffer;
+  const char *inputEnd;
+  const char *inputPtr;
+  enum InputKind inputKind;
+  int *lineStarts;            // offsets of line starts, built on the first diagnostic
+  int lineCount;
+  int currentChar;
+
+  // Scanner
+  char *identBuffer;          // upper-cased spelling of the identifier being scanned
+  int identCapacity;
+  Token tokenRing[TOKEN_RING_SIZE];
+  int tokenRingNext;
+  InternTable internTable;
+
+  // Parser
+  Token *currentToken;
+  Token *lookAhead;
+  Token insertedToken;        // stands in for a token that eat() found missing
+  TokenStream *tokenStream;   // feeds scan() when pretokenizing
+  int streamPos;
+
+  // Symbol table and syntax tree
+  SymTab *symtab;
+  Arena arena;                // every object, type and scope of the symbol table
+  Type *intType;
+  Type *charType;
+  Ast ast;
+
+  // Diagnostics
+  FILE *output;               // diagnostics and the symbol table dump
+  int errorCount;
+  int lastErrorOffset;        // complaints about a token that already has one are cascades
+};
+
+KplCompiler *createCompiler(void);
+void freeCompiler(KplCompiler *compiler);
+void copyOptions(KplCompiler *compiler, KplCompiler *options);
+
+#endif
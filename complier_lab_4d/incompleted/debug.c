@@ -5,97 +5,141 @@
  */
 
 #include <stdio.h>
+#include "reader.h"
 #include "debug.h"
+#include "ast.h"
+#include "compiler.h"
 
-void pad(int n) {
+void pad(FILE *out, int n) {
   int i;
-  for (i = 0; i < n ; i++) printf(" ");
+  for (i = 0; i < n ; i++) fprintf(out, " ");
 }
 
-void printType(Type* type) {
+void printType(FILE *out, Type* type) {
   switch (type->typeClass) {
   case TP_INT:
-    printf("Int");
+    fprintf(out, "Int");
     break;
   case TP_CHAR:
-    printf("Char");
+    fprintf(out, "Char");
     break;
   case TP_ARRAY:
-    printf("Arr(%d,",type->arraySize);
-    printType(type->elementType);
-    printf(")");
+    fprintf(out, "Arr(%d,",type->arraySize);
+    printType(out, type->elementType);
+    fprintf(out, ")");
     break;
   }
 }
 
-void printConstantValue(ConstantValue* value) {
+void printConstantValue(FILE *out, ConstantValue* value) {
   switch (value->type) {
   case TP_INT:
-    printf("%d",value->intValue);
+    fprintf(out, "%d",value->intValue);
     break;
   case TP_CHAR:
-    printf("\'%c\'",value->charValue);
+    fprintf(out, "\'%c\'",value->charValue);
     break;
   default:
     break;
   }
 }
 
-void printObject(Object* obj, int indent) {
+void printObject(FILE *out, Object* obj, int indent) {
   switch (obj->kind) {
   case OBJ_CONSTANT:
-    pad(indent);
-    printf("Const %s = ", obj->name);
-    printConstantValue(obj->constAttrs->value);
+    pad(out, indent);
+    fprintf(out, "Const %s = ", obj->name);
+    printConstantValue(out, obj->constAttrs.value);
     break;
   case OBJ_TYPE:
-    pad(indent);
-    printf("Type %s = ", obj->name);
-    printType(obj->typeAttrs->actualType);
+    pad(out, indent);
+    fprintf(out, "Type %s = ", obj->name);
+    printType(out, obj->typeAttrs.actualType);
     break;
   case OBJ_VARIABLE:
-    pad(indent);
-    printf("Var %s : ", obj->name);
-    printType(obj->varAttrs->type);
+    pad(out, indent);
+    fprintf(out, "Var %s : ", obj->name);
+    printType(out, obj->varAttrs.type);
     break;
   case OBJ_PARAMETER:
-    pad(indent);
-    if (obj->paramAttrs->kind == PARAM_VALUE) 
-      printf("Param %s : ", obj->name);
+    pad(out, indent);
+    if (obj->paramAttrs.kind == PARAM_VALUE) 
+      fprintf(out, "Param %s : ", obj->name);
     else
-      printf("Param VAR %s : ", obj->name);
-    printType(obj->paramAttrs->type);
+      fprintf(out, "Param VAR %s : ", obj->name);
+    printType(out, obj->paramAttrs.type);
     break;
   case OBJ_FUNCTION:
-    pad(indent);
-    printf("Function %s : ",obj->name);
-    printType(obj->funcAttrs->returnType);
-    printf("\n");
-    printScope(obj->funcAttrs->scope, indent + 4);
+    pad(out, indent);
+    fprintf(out, "Function %s : ",obj->name);
+    printType(out, obj->funcAttrs.returnType);
+    fprintf(out, "\n");
+    printScope(out, obj->funcAttrs.scope, indent + 4);
     break;
   case OBJ_PROCEDURE:
-    pad(indent);
-    printf("Procedure %s\n",obj->name);
-    printScope(obj->procAttrs->scope, indent + 4);
+    pad(out, indent);
+    fprintf(out, "Procedure %s\n",obj->name);
+    printScope(out, obj->procAttrs.scope, indent + 4);
     break;
   case OBJ_PROGRAM:
-    pad(indent);
-    printf("Program %s\n",obj->name);
-    printScope(obj->progAttrs->scope, indent + 4);
+    pad(out, indent);
+    fprintf(out, "Program %s\n",obj->name);
+    printScope(out, obj->progAttrs.scope, indent + 4);
     break;
   }
 }
 
-void printObjectList(ObjectNode* objList, int indent) {
+void printObjectList(FILE *out, ObjectNode* objList, int indent) {
   ObjectNode *node = objList;
   while (node != NULL) {
-    printObject(node->object, indent);
-    printf("\n");
+    printObject(out, node->object, indent);
+    fprintf(out, "\n");
     node = node->next;
   }
 }
 
-void printScope(Scope* scope, int indent) {
-  printObjectList(scope->objList, indent);
+void printScope(FILE *out, Scope* scope, int indent) {
+  printObjectList(out, scope->objList, indent);
 }
 
+
+static Scope* routineScope(Object* owner) {
+  switch (owner->kind) {
+  case OBJ_FUNCTION:
+    return owner->funcAttrs.scope;
+  case OBJ_PROCEDURE:
+    return owner->procAttrs.scope;
+  default:
+    return owner->progAttrs.scope;
+  }
+}
+
+// Lists each routine's frame, in the order their bodies end, then every
+// variable, parameter and function result use with the (depth, offset) it
+// resolved to
+void printFrames(KplCompiler *compiler) {
+  FILE *out = compiler->output;
+  ObjectNode *node;
+  ExprNode *expr;
+  Scope *scope;
+  uint32_t i;
+  int lineNo, colNo;
+
+  for (i = 1; i < compiler->ast.routineCount; i++) {
+    scope = routineScope(compiler->ast.routines[i].owner);
+    fprintf(out, "Frame %s at level %d, %d words\n", scope->owner->name, scope->level, scope->frameSize);
+    for (node = scope->objList; node != NULL; node = node->next)
+      if (node->object->kind == OBJ_VARIABLE)
+        fprintf(out, "    Var %s at %d\n", node->object->name, node->object->varAttrs.localOffset);
+      else if (node->object->kind == OBJ_PARAMETER)
+        fprintf(out, "    Param %s at %d\n", node->object->name, node->object->paramAttrs.localOffset);
+  }
+
+  for (i = 1; i < compiler->ast.exprCount; i++) {
+    expr = &compiler->ast.exprs[i];
+    if ((expr->kind != EXP_VARIABLE) && (expr->kind != EXP_PARAMETER) && (expr->kind != EXP_FUNCTION))
+      continue;
+    offsetToPosition(compiler, expr->offset, &lineNo, &colNo);
+    fprintf(out, "%d-%d:%s depth %d, offset %d\n", lineNo, colNo, expr->object->name, expr->depth, expr->frameOffset);
+  }
+}
@@ -0,0 +1,36 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __DFA_H__
+#define __DFA_H__
+
+#include "token.h"
+#include "error.h"
+
+// The tables themselves are generated from scanner.spec into dfa.c by gendfa
+#define DFA_DEAD 0
+#define DFA_START 1
+
+// What the scanner does when no transition leads out of a state
+typedef enum {
+  DFA_EOF,            // only the start state, on the sentinel's class
+  DFA_ACCEPT,         // return a token of tokenType
+  DFA_ERROR,          // report error at the start of the token
+  DFA_SKIP_BLANKS,    // skip the rest of a run of blanks and start over
+  DFA_SKIP_COMMENT    // skip to the end of a comment and start over
+} DfaAction;
+
+typedef struct {
+  DfaAction action;
+  TokenType tokenType;
+  ErrorCode error;
+} DfaState;
+
+extern const DfaState dfaStates[];
+// Indexed by state and raw byte; gendfa folds charCodes[] into the table
+extern const unsigned char dfaNext[][256];
+
+#endif
@@ -0,0 +1,147 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "reader.h"
+#include "parser.h"
+#include "driver.h"
+#include "timer.h"
+
+struct CompileJob_ {
+  char *fileName;
+  char *output;       // everything the compilation printed
+  size_t outputSize;
+  int unreadable;
+  int errorCount;
+  double seconds;
+  int done;
+};
+
+typedef struct CompileJob_ CompileJob;
+
+struct Batch_ {
+  KplCompiler *options;
+  CompileJob *jobs;
+  int jobCount;
+  int nextJob;
+  pthread_mutex_t lock;
+  pthread_cond_t jobDone;
+};
+
+typedef struct Batch_ Batch;
+
+// compileSource() leaves the compiler ready for the next file, keeping its storage
+static void runJob(KplCompiler *compiler, CompileJob *job) {
+  double start = now();
+  FILE *output;
+
+  output = open_memstream(&job->output, &job->outputSize);
+  compiler->output = output;
+
+  if (compile(compiler, job->fileName) == IO_ERROR) {
+    fprintf(output, "Can\'t read input file!\n");
+    job->unreadable = 1;
+  } else job->errorCount = compiler->errorCount;
+
+  fclose(output);
+  job->seconds = now() - start;
+}
+
+// Workers take the files in order, so the printer rarely waits long. Each
+// compiles all its files with one KplCompiler, as a server connection does.
+static void *compileWorker(void *arg) {
+  Batch *batch = (Batch*) arg;
+  KplCompiler *compiler = createCompiler();
+  CompileJob *job;
+
+  copyOptions(compiler, batch->options);
+  while (1) {
+    pthread_mutex_lock(&batch->lock);
+    job = (batch->nextJob < batch->jobCount) ? &batch->jobs[batch->nextJob++] : NULL;
+    pthread_mutex_unlock(&batch->lock);
+    if (job == NULL)
+      break;
+
+    runJob(compiler, job);
+
+    pthread_mutex_lock(&batch->lock);
+    job->done = 1;
+    pthread_cond_broadcast(&batch->jobDone);
+    pthread_mutex_unlock(&batch->lock);
+  }
+  freeCompiler(compiler);
+  return NULL;
+}
+
+int compileFiles(KplCompiler *options, char **fileNames, int fileCount, int threadCount) {
+  Batch batch;
+  pthread_t *threads;
+  double start = now();
+  double busy = 0;
+  int failed = 0, unreadable = 0;
+  int started, i;
+
+  if (threadCount < 1)
+    threadCount = 1;
+  if (threadCount > fileCount)
+    threadCount = fileCount;
+
+  batch.options = options;
+  batch.jobs = (CompileJob*) calloc(fileCount, sizeof(CompileJob));
+  batch.jobCount = fileCount;
+  batch.nextJob = 0;
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.jobDone, NULL);
+  for (i = 0; i < fileCount; i++)
+    batch.jobs[i].fileName = fileNames[i];
+
+  threads = (pthread_t*) malloc(threadCount * sizeof(pthread_t));
+  for (started = 0; started < threadCount; started++)
+    if (pthread_create(&threads[started], NULL, compileWorker, &batch) != 0)
+      break;
+  // The files no thread could be started for are compiled on this one
+  if (started < threadCount) {
+    threadCount = started + 1;
+    compileWorker(&batch);
+  }
+
+  // Each file's output is printed as soon as it and all before it are done
+  for (i = 0; i < fileCount; i++) {
+    CompileJob *job = &batch.jobs[i];
+
+    pthread_mutex_lock(&batch.lock);
+    while (!job->done)
+      pthread_cond_wait(&batch.jobDone, &batch.lock);
+    pthread_mutex_unlock(&batch.lock);
+
+    printf("%s:\n", job->fileName);
+    fwrite(job->output, 1, job->outputSize, stdout);
+    free(job->output);
+
+    if (job->unreadable)
+      unreadable ++;
+    else if (job->errorCount > 0)
+      failed ++;
+    busy += job->seconds;
+  }
+
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  fflush(stdout);
+  fprintf(stderr, "%d files, %d with errors, %d unreadable: %.3f s on %d threads (%.3f s compiling)\n",
+          fileCount, failed, unreadable, now() - start, threadCount, busy);
+
+  pthread_mutex_destroy(&batch.lock);
+  pthread_cond_destroy(&batch.jobDone);
+  free(threads);
+  free(batch.jobs);
+
+  if (unreadable > 0)
+    return -1;
+  return (failed > 0) ? 1 : 0;
+}
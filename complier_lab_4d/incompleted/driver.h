@@ -0,0 +1,18 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __DRIVER_H__
+#define __DRIVER_H__
+
+#include "compiler.h"
+
+// Compiles every file on threadCount workers, each reusing one KplCompiler
+// that takes its options from the given one. Output is printed file by file in
+// the order given, and a timing summary goes to stderr. Returns the exit
+// status: -1 if a file could not be read, 1 if any had errors, else 0.
+int compileFiles(KplCompiler *options, char **fileNames, int fileCount, int threadCount);
+
+#endif
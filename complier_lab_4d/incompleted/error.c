@@ -6,18 +6,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "reader.h"
 #include "error.h"
+#include "compiler.h"
 
-#define NUM_OF_ERRORS 29
 
 struct ErrorMessage {
   ErrorCode errorCode;
   char *message;
 };
 
-struct ErrorMessage errors[29] = {
+struct ErrorMessage errors[NUM_OF_ERRORS] = {
   {ERR_END_OF_COMMENT, "End of comment expected."},
   {ERR_IDENT_TOO_LONG, "Identifier too long."},
+  {ERR_NUMBER_TOO_LARGE, "Number too large."},
   {ERR_INVALID_CONSTANT_CHAR, "Invalid char constant."},
   {ERR_INVALID_SYMBOL, "Invalid symbol."},
   {ERR_INVALID_IDENT, "An identifier expected."},
@@ -44,21 +46,43 @@ struct ErrorMessage errors[29] = {
   {ERR_UNDECLARED_PROCEDURE, "Undeclared procedure."},
   {ERR_DUPLICATE_IDENT, "Duplicate identifier."},
   {ERR_TYPE_INCONSISTENCY, "Type inconsistency"},
-  {ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, "The number of arguments and the number of parameters are inconsistent."}
+  {ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, "The number of arguments and the number of parameters are inconsistent."},
+  {ERR_ARRAY_TOO_LARGE, "Array too large."},
+  {ERR_FRAME_TOO_LARGE, "Too many variables in one frame."}
 };
 
-void error(ErrorCode err, int lineNo, int colNo) {
+void clearErrors(KplCompiler *compiler) {
+  compiler->errorCount = 0;
+  compiler->lastErrorOffset = -1;
+}
+
+void error(KplCompiler *compiler, ErrorCode err, int offset) {
   int i;
+  int lineNo, colNo;
+
+  if (offset == compiler->lastErrorOffset)
+    return;
+  compiler->lastErrorOffset = offset;
+  compiler->errorCount ++;
+
+  offsetToPosition(compiler, offset, &lineNo, &colNo);
   for (i = 0 ; i < NUM_OF_ERRORS; i ++) 
     if (errors[i].errorCode == err) {
-      printf("%d-%d:%s\n", lineNo, colNo, errors[i].message);
-      exit(0);
+      fprintf(compiler->output, "%d-%d:%s\n", lineNo, colNo, errors[i].message);
+      return;
     }
 }
 
-void missingToken(TokenType tokenType, int lineNo, int colNo) {
-  printf("%d-%d:Missing %s\n", lineNo, colNo, tokenToString(tokenType));
-  exit(0);
+void missingToken(KplCompiler *compiler, TokenType tokenType, int offset) {
+  int lineNo, colNo;
+
+  if (offset == compiler->lastErrorOffset)
+    return;
+  compiler->lastErrorOffset = offset;
+  compiler->errorCount ++;
+
+  offsetToPosition(compiler, offset, &lineNo, &colNo);
+  fprintf(compiler->output, "%d-%d:Missing %s\n", lineNo, colNo, tokenToString(tokenType));
 }
 
 void assert(char *msg) {
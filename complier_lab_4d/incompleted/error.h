@@ -11,6 +11,7 @@
 typedef enum {
   ERR_END_OF_COMMENT,
   ERR_IDENT_TOO_LONG,
+  ERR_NUMBER_TOO_LARGE,
   ERR_INVALID_CONSTANT_CHAR,
   ERR_INVALID_SYMBOL,
   ERR_INVALID_IDENT,
@@ -37,11 +38,18 @@ typedef enum {
   ERR_UNDECLARED_PROCEDURE,
   ERR_DUPLICATE_IDENT,
   ERR_TYPE_INCONSISTENCY,
-  ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY
+  ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY,
+  ERR_ARRAY_TOO_LARGE,
+  ERR_FRAME_TOO_LARGE
 } ErrorCode;
 
-void error(ErrorCode err, int lineNo, int colNo);
-void missingToken(TokenType tokenType, int lineNo, int colNo);
+#define NUM_OF_ERRORS 32
+
+// Diagnostics are printed as they are found and counted in the compiler;
+// parsing goes on
+void clearErrors(KplCompiler *compiler);
+void error(KplCompiler *compiler, ErrorCode err, int offset);
+void missingToken(KplCompiler *compiler, TokenType tokenType, int offset);
 void assert(char *msg);
 
 #endif
@@ -0,0 +1,342 @@
+/* Scanner table generator
+ *
+ * Reads the character classes from charcode.h and the rules from
+ * scanner.spec, builds the DFA by subset construction and writes the
+ * tables declared in dfa.h. The transitions are written per byte, with
+ * charCodes[] folded in, so the scanner does one lookup per character.
+ *
+ *   gendfa charcode.h scanner.spec dfa.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "charcode.h"
+
+#define MAX_CLASSES 64
+#define MAX_RULES 64
+#define MAX_ELEMENTS 8
+#define MAX_ITEMS (MAX_RULES * (MAX_ELEMENTS + 1))
+#define MAX_STATES 255
+#define MAX_NAME_LEN 64
+#define MAX_LINE_LEN 512
+
+typedef enum {
+  RULE_TOKEN,
+  RULE_SKIP_BLANKS,
+  RULE_SKIP_COMMENT,
+  RULE_ERROR
+} RuleKind;
+
+// One element of a pattern: a set of classes, optionally repeated
+typedef struct {
+  char classes[MAX_CLASSES];
+  int repeated;
+} Element;
+
+typedef struct {
+  RuleKind kind;
+  char name[MAX_NAME_LEN];      // token type or error code
+  char otherwise[MAX_NAME_LEN]; // error when the input stops inside the rule
+  Element elements[MAX_ELEMENTS];
+  int length;
+  int line;
+} Rule;
+
+// A DFA state is the set of (rule, position) items it stands for
+typedef struct {
+  char items[MAX_ITEMS];
+  int next[MAX_CLASSES];
+} State;
+
+char classNames[MAX_CLASSES][MAX_NAME_LEN];
+int classCount = 0;
+
+Rule rules[MAX_RULES];
+int ruleCount = 0;
+
+State states[MAX_STATES + 1];
+int stateCount = 0;
+
+const char *specName;
+
+extern CharCode charCodes[];
+
+void fail(int line, const char *message, const char *detail) {
+  if (line > 0)
+    fprintf(stderr, "%s:%d: %s %s\n", specName, line, message, detail);
+  else fprintf(stderr, "gendfa: %s %s\n", message, detail);
+  exit(1);
+}
+
+/******************************************************************/
+
+// The class names are the enumerators of CharCode, in declaration order
+void readClasses(const char *fileName) {
+  FILE *f = fopen(fileName, "r");
+  char word[MAX_NAME_LEN];
+  int inEnum = 0;
+  int c, n;
+
+  if (f == NULL)
+    fail(0, "cannot open", fileName);
+  while ((c = fgetc(f)) != EOF) {
+    if (c == '{') inEnum = 1;
+    else if (c == '}') inEnum = 0;
+    else if (inEnum && (isalpha(c) || (c == '_'))) {
+      n = 0;
+      do {
+        if (n < MAX_NAME_LEN - 1) word[n++] = c;
+        c = fgetc(f);
+      } while (isalnum(c) || (c == '_'));
+      word[n] = '\0';
+      ungetc(c, f);
+      if (strncmp(word, "CHAR_", 5) == 0) {
+        if (classCount == MAX_CLASSES)
+          fail(0, "too many classes in", fileName);
+        strcpy(classNames[classCount++], word + 5);
+      }
+    }
+  }
+  fclose(f);
+  if (classCount == 0)
+    fail(0, "no CharCode enumerators in", fileName);
+}
+
+int findClass(const char *name) {
+  int i;
+  for (i = 0; i < classCount; i++)
+    if (strcmp(classNames[i], name) == 0)
+      return i;
+  return -1;
+}
+
+void markClasses(Element *element, const char *name, char value, int line) {
+  if (strcmp(name, "ANY") == 0)
+    memset(element->classes, value, classCount);
+  else if (findClass(name) >= 0)
+    element->classes[findClass(name)] = value;
+  else fail(line, "unknown character class", name);
+}
+
+// Parses "A|B*", "ANY-C" and friends into one element
+void parseElement(Element *element, char *word, int line) {
+  char *name, *except;
+  int length = strlen(word);
+
+  memset(element, 0, sizeof(Element));
+  if ((length > 0) && (word[length - 1] == '*')) {
+    element->repeated = 1;
+    word[length - 1] = '\0';
+  }
+  for (name = strtok(word, "|"); name != NULL; name = strtok(NULL, "|")) {
+    if ((except = strchr(name, '-')) != NULL)
+      *except++ = '\0';
+    markClasses(element, name, 1, line);
+    if (except != NULL)
+      markClasses(element, except, 0, line);
+  }
+}
+
+void readRules(const char *fileName) {
+  FILE *f = fopen(fileName, "r");
+  char text[MAX_LINE_LEN];
+  char *words[MAX_LINE_LEN / 2];
+  int line = 0;
+  int count, i;
+  Rule *rule;
+
+  if (f == NULL)
+    fail(0, "cannot open", fileName);
+  while (fgets(text, MAX_LINE_LEN, f) != NULL) {
+    line ++;
+    if (strchr(text, '#') != NULL)
+      *strchr(text, '#') = '\0';
+    count = 0;
+    for (words[0] = strtok(text, " \t\r\n"); words[count] != NULL; words[count] = strtok(NULL, " \t\r\n"))
+      count ++;
+    if (count == 0)
+      continue;
+    if (count < 3)
+      fail(line, "expected a pattern after", words[count - 1]);
+    if (ruleCount == MAX_RULES)
+      fail(line, "too many rules", "");
+
+    rule = &rules[ruleCount++];
+    memset(rule, 0, sizeof(Rule));
+    rule->line = line;
+    if (strcmp(words[0], "token") == 0) {
+      rule->kind = RULE_TOKEN;
+      strcpy(rule->name, words[1]);
+    } else if (strcmp(words[0], "error") == 0) {
+      rule->kind = RULE_ERROR;
+      strcpy(rule->name, words[1]);
+    } else if ((strcmp(words[0], "skip") == 0) && (strcmp(words[1], "blanks") == 0)) {
+      rule->kind = RULE_SKIP_BLANKS;
+    } else if ((strcmp(words[0], "skip") == 0) && (strcmp(words[1], "comment") == 0)) {
+      rule->kind = RULE_SKIP_COMMENT;
+    } else fail(line, "unknown rule", words[0]);
+
+    if ((count > 4) && (strcmp(words[count - 2], "else") == 0)) {
+      strcpy(rule->otherwise, words[count - 1]);
+      count -= 2;
+    }
+    for (i = 2; i < count; i++) {
+      if (rule->length == MAX_ELEMENTS)
+        fail(line, "pattern too long", "");
+      parseElement(&rule->elements[rule->length++], words[i], line);
+    }
+    for (i = 0; (i < rule->length) && rule->elements[i].repeated; i++);
+    if (i == rule->length)
+      fail(line, "pattern matches the empty string", "");
+  }
+  fclose(f);
+}
+
+/******************************************************************/
+
+#define ITEM(rule, position) ((rule) * (MAX_ELEMENTS + 1) + (position))
+
+// A repeated element may be skipped, so the item after it is also live
+void closure(char *items) {
+  int r, i;
+  for (r = 0; r < ruleCount; r++)
+    for (i = 0; i < rules[r].length; i++)
+      if (items[ITEM(r, i)] && rules[r].elements[i].repeated)
+        items[ITEM(r, i + 1)] = 1;
+}
+
+int addState(char *items) {
+  int s;
+
+  for (s = 1; s <= stateCount; s++)
+    if (memcmp(states[s].items, items, MAX_ITEMS) == 0)
+      return s;
+  if (stateCount == MAX_STATES)
+    fail(0, "too many states", "");
+  s = ++stateCount;
+  memcpy(states[s].items, items, MAX_ITEMS);
+  return s;
+}
+
+// The scanner runs the DFA without bounds checks, relying on the sentinel
+// past the input, class END, to stop every state; a rule that moves on it
+// would let the scanner read past the buffer
+void buildStates(void) {
+  char items[MAX_ITEMS];
+  int endClass = findClass("END");
+  int s, c, r, i, empty;
+
+  if (endClass < 0)
+    fail(0, "no END class for the sentinel", "");
+
+  memset(items, 0, MAX_ITEMS);
+  for (r = 0; r < ruleCount; r++)
+    items[ITEM(r, 0)] = 1;
+  closure(items);
+  addState(items);
+
+  // States are numbered in the order they are found, so the loop also visits new ones
+  for (s = 1; s <= stateCount; s++)
+    for (c = 0; c < classCount; c++) {
+      memset(items, 0, MAX_ITEMS);
+      empty = 1;
+      for (r = 0; r < ruleCount; r++)
+        for (i = 0; i < rules[r].length; i++)
+          if (states[s].items[ITEM(r, i)] && rules[r].elements[i].classes[c]) {
+            if (c == endClass)
+              fail(rules[r].line, "pattern moves on END, the sentinel; write ANY-END for ANY", "");
+            items[ITEM(r, rules[r].elements[i].repeated ? i : i + 1)] = 1;
+            empty = 0;
+          }
+      if (empty)
+        states[s].next[c] = 0;
+      else {
+        closure(items);
+        states[s].next[c] = addState(items);
+      }
+    }
+}
+
+/******************************************************************/
+
+// The first complete rule decides; otherwise the unfinished rules must agree on an error
+void writeState(FILE *out, int s) {
+  const char *otherwise = NULL;
+  int r, i;
+
+  for (r = 0; r < ruleCount; r++)
+    if (states[s].items[ITEM(r, rules[r].length)])
+      break;
+  if (r < ruleCount) {
+    switch (rules[r].kind) {
+    case RULE_TOKEN:
+      fprintf(out, "  [%d] = {DFA_ACCEPT, %s, 0},\n", s, rules[r].name); break;
+    case RULE_ERROR:
+      fprintf(out, "  [%d] = {DFA_ERROR, TK_NONE, %s},\n", s, rules[r].name); break;
+    case RULE_SKIP_BLANKS:
+      fprintf(out, "  [%d] = {DFA_SKIP_BLANKS, TK_NONE, 0},\n", s); break;
+    case RULE_SKIP_COMMENT:
+      fprintf(out, "  [%d] = {DFA_SKIP_COMMENT, TK_NONE, 0},\n", s); break;
+    }
+    return;
+  }
+
+  if (s == 1) {
+    fprintf(out, "  [%d] = {DFA_EOF, TK_EOF, 0},\n", s);
+    return;
+  }
+
+  for (r = 0; r < ruleCount; r++)
+    for (i = 0; i < rules[r].length; i++)
+      if (states[s].items[ITEM(r, i)]) {
+        if (rules[r].otherwise[0] == '\0')
+          fail(rules[r].line, "rule can stop before it is complete and needs an else", "");
+        if ((otherwise != NULL) && (strcmp(otherwise, rules[r].otherwise) != 0))
+          fail(rules[r].line, "conflicting else errors with", otherwise);
+        otherwise = rules[r].otherwise;
+      }
+  fprintf(out, "  [%d] = {DFA_ERROR, TK_NONE, %s},\n", s, otherwise);
+}
+
+void writeTables(const char *fileName) {
+  FILE *out = fopen(fileName, "w");
+  int s, b;
+
+  if (out == NULL)
+    fail(0, "cannot write", fileName);
+  fprintf(out, "/* Generated by gendfa from %s; do not edit */\n\n", specName);
+  fprintf(out, "#include \"dfa.h\"\n\n");
+
+  fprintf(out, "const DfaState dfaStates[%d] = {\n", stateCount + 1);
+  fprintf(out, "  [DFA_DEAD] = {DFA_ERROR, TK_NONE, 0},\n");
+  for (s = 1; s <= stateCount; s++)
+    writeState(out, s);
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "const unsigned char dfaNext[%d][256] = {\n", stateCount + 1);
+  for (s = 1; s <= stateCount; s++) {
+    fprintf(out, "  [%d] = {", s);
+    for (b = 0; b < 256; b++)
+      fprintf(out, "%s%d,", (b % 32 == 0) ? "\n    " : " ", states[s].next[charCodes[b]]);
+    fprintf(out, "\n  },\n");
+  }
+  fprintf(out, "};\n");
+
+  if (fclose(out) != 0)
+    fail(0, "cannot write", fileName);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "usage: gendfa charcode.h scanner.spec dfa.c\n");
+    return 1;
+  }
+  specName = argv[2];
+  readClasses(argv[1]);
+  readRules(argv[2]);
+  buildStates();
+  writeTables(argv[3]);
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+#define INTERN_BLOCK_SIZE 65536
+#define INTERN_INITIAL_SLOTS 1024
+#define EMPTY_SLOT -1
+
+struct InternEntry_ {
+  char *string;
+  int length;
+  unsigned hash;
+};
+
+typedef struct InternEntry_ InternEntry;
+
+// Strings live in blocks that never move, so internedString() pointers stay valid
+struct InternBlock_ {
+  struct InternBlock_ *next;
+  int used;
+  int size;
+  char chars[];
+};
+
+typedef struct InternBlock_ InternBlock;
+
+unsigned hashChars(const char *chars, int length) {
+  unsigned hash = 2166136261u;
+  int i;
+  for (i = 0; i < length; i++) {
+    hash ^= (unsigned char) chars[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+char *storeChars(InternTable *table, const char *chars, int length) {
+  char *string;
+
+  if ((table->blocks == NULL) || (table->blocks->used + length + 1 > table->blocks->size)) {
+    int size = (length + 1 > INTERN_BLOCK_SIZE) ? length + 1 : INTERN_BLOCK_SIZE;
+    InternBlock *block = (InternBlock*) malloc(sizeof(InternBlock) + size);
+    block->next = table->blocks;
+    block->used = 0;
+    block->size = size;
+    table->blocks = block;
+  }
+  string = table->blocks->chars + table->blocks->used;
+  memcpy(string, chars, length);
+  string[length] = '\0';
+  table->blocks->used += length + 1;
+  return string;
+}
+
+void rehashSlots(InternTable *table, int slotCount) {
+  int i;
+
+  free(table->slots);
+  table->slots = (int*) malloc(slotCount * sizeof(int));
+  table->slotCount = slotCount;
+  for (i = 0; i < slotCount; i++)
+    table->slots[i] = EMPTY_SLOT;
+  for (i = 0; i < table->count; i++) {
+    int slot = table->entries[i].hash & (slotCount - 1);
+    while (table->slots[slot] != EMPTY_SLOT)
+      slot = (slot + 1) & (slotCount - 1);
+    table->slots[slot] = i;
+  }
+}
+
+int internChars(InternTable *table, const char *chars, int length) {
+  unsigned hash = hashChars(chars, length);
+  int slot;
+  InternEntry *entry;
+
+  if (table->slots == NULL)
+    rehashSlots(table, INTERN_INITIAL_SLOTS);
+
+  slot = hash & (table->slotCount - 1);
+  while (table->slots[slot] != EMPTY_SLOT) {
+    entry = &table->entries[table->slots[slot]];
+    if ((entry->hash == hash) && (entry->length == length) && (memcmp(entry->string, chars, length) == 0))
+      return table->slots[slot];
+    slot = (slot + 1) & (table->slotCount - 1);
+  }
+
+  if (table->count == table->capacity) {
+    table->capacity = (table->capacity == 0) ? INTERN_INITIAL_SLOTS / 2 : table->capacity * 2;
+    table->entries = (InternEntry*) realloc(table->entries, table->capacity * sizeof(InternEntry));
+  }
+  entry = &table->entries[table->count];
+  entry->string = storeChars(table, chars, length);
+  entry->length = length;
+  entry->hash = hash;
+  table->slots[slot] = table->count;
+  table->count ++;
+
+  // Keep the load factor at or below one half
+  if (table->count * 2 > table->slotCount)
+    rehashSlots(table, table->slotCount * 2);
+
+  return table->count - 1;
+}
+
+int internString(InternTable *table, const char *string) {
+  return internChars(table, string, strlen(string));
+}
+
+char *internedString(InternTable *table, int id) {
+  return table->entries[id].string;
+}
+
+int internCount(InternTable *table) {
+  return table->count;
+}
+
+// Keeps the entries and the newest block for the next compilation. A slot
+// array grown by a large input is dropped, so small inputs don't clear it.
+void resetInternTable(InternTable *table) {
+  InternBlock *block;
+  int i;
+
+  if (table->blocks != NULL) {
+    while ((block = table->blocks->next) != NULL) {
+      table->blocks->next = block->next;
+      free(block);
+    }
+    table->blocks->used = 0;
+  }
+  if (table->slotCount > INTERN_INITIAL_SLOTS) {
+    free(table->slots);
+    table->slots = NULL;
+    table->slotCount = 0;
+  } else {
+    for (i = 0; i < table->slotCount; i++)
+      table->slots[i] = EMPTY_SLOT;
+  }
+  table->count = 0;
+}
+
+void freeInternTable(InternTable *table) {
+  while (table->blocks != NULL) {
+    InternBlock *block = table->blocks;
+    table->blocks = block->next;
+    free(block);
+  }
+  free(table->entries);
+  free(table->slots);
+  memset(table, 0, sizeof(InternTable));
+}
@@ -0,0 +1,35 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+// Every distinct identifier is stored once and named by a small integer id,
+// so names can be compared with == and copied as ints.
+
+struct InternEntry_;
+struct InternBlock_;
+
+struct InternTable_ {
+  struct InternEntry_ *entries;
+  int count;
+  int capacity;
+  int *slots;
+  int slotCount;
+  struct InternBlock_ *blocks;
+};
+
+typedef struct InternTable_ InternTable;
+
+// A zeroed InternTable is empty and ready to use
+int internChars(InternTable *table, const char *chars, int length);
+int internString(InternTable *table, const char *string);
+char *internedString(InternTable *table, int id);
+int internCount(InternTable *table);
+void resetInternTable(InternTable *table);
+void freeInternTable(InternTable *table);
+
+#endif
@@ -6,22 +6,71 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "reader.h"
 #include "parser.h"
+#include "error.h"
+#include "compiler.h"
+#include "driver.h"
+#include "server.h"
 
 /******************************************************************/
 
 int main(int argc, char *argv[]) {
-  if (argc <= 1) {
+  KplCompiler *compiler = createCompiler();
+  int status;
+  int jobs = 0;
+  int arg = 1;
+
+  while (argc > arg) {
+    if (strcmp(argv[arg], "--pretokenize") == 0) {
+      compiler->pretokenize = 1;
+      arg ++;
+    } else if ((strcmp(argv[arg], "--lex-threads") == 0) && (argc > arg + 1)) {
+      // Parallel lexing fills the token stream before parsing starts
+      compiler->lexThreads = atoi(argv[arg + 1]);
+      compiler->pretokenize = 1;
+      arg += 2;
+    } else if ((strcmp(argv[arg], "--token-cache") == 0) && (argc > arg + 1)) {
+      compiler->tokenCacheDir = argv[arg + 1];
+      compiler->pretokenize = 1;
+      arg += 2;
+    } else if (strcmp(argv[arg], "--dump-frames") == 0) {
+      compiler->dumpFrames = 1;
+      arg ++;
+    } else if (strcmp(argv[arg], "--server") == 0) {
+      // Compiles sources sent over a socket, or stdin if none is given
+      status = (argc > arg + 1) ? serveSocket(compiler, argv[arg + 1]) : serveStdio(compiler);
+      freeCompiler(compiler);
+      return status;
+    } else if ((strcmp(argv[arg], "-j") == 0) && (argc > arg + 1)) {
+      // Compiles many files in one process; see compileFiles()
+      jobs = atoi(argv[arg + 1]);
+      arg += 2;
+    } else break;
+  }
+
+  if (argc <= arg) {
     printf("parser: no input file.\n");
+    freeCompiler(compiler);
     return -1;
   }
 
-  if (compile(argv[1]) == IO_ERROR) {
+  if ((jobs > 0) || (argc > arg + 1)) {
+    status = compileFiles(compiler, argv + arg, argc - arg, jobs);
+    freeCompiler(compiler);
+    return status;
+  }
+
+  if (compile(compiler, argv[arg]) == IO_ERROR) {
     printf("Can\'t read input file!\n");
+    freeCompiler(compiler);
     return -1;
   }
     
-  return 0;
+  // Every diagnostic has been printed by now
+  status = (compiler->errorCount > 0) ? 1 : 0;
+  freeCompiler(compiler);
+  return status;
 }
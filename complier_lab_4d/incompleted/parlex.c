@@ -0,0 +1,183 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "reader.h"
+#include "scanner.h"
+#include "intern.h"
+#include "parlex.h"
+#include "compiler.h"
+
+// Smaller inputs are not worth the thread start-up
+#ifndef MIN_LEX_CHUNK
+#define MIN_LEX_CHUNK (1 << 20)
+#endif
+
+/*
+ * Each chunk is lexed speculatively from a guessed boundary, which may lie
+ * inside a comment, a token or a char constant. The scanner carries no state
+ * between tokens other than the reader position, so once the real lexer
+ * reaches a position where a chunk started one of its tokens, everything the
+ * chunk produced from there on is exactly what sequential lexing would give.
+ */
+struct LexChunk_ {
+  const char *text;
+  int length;
+  int start;
+  int end;
+  TokenStream tokens;
+  uint32_t *starts;   // reader position before each token was lexed
+  int stop;           // reader position after the last token
+  KplCompiler *lexer; // the chunk's own reader, scanner and intern table
+};
+
+typedef struct LexChunk_ LexChunk;
+
+void *lexChunk(void *arg) {
+  LexChunk *chunk = (LexChunk*) arg;
+  Token *token;
+  int position;
+  int startsCapacity = 0;
+
+  chunk->lexer = createCompiler();
+  openInputView(chunk->lexer, chunk->text, chunk->length, chunk->start);
+  initTokenStream(&chunk->tokens);
+  chunk->starts = NULL;
+
+  while ((position = currentOffset(chunk->lexer)) < chunk->end) {
+    token = getToken(chunk->lexer);
+    appendToken(&chunk->tokens, token);
+    if (chunk->tokens.capacity > startsCapacity) {
+      startsCapacity = chunk->tokens.capacity;
+      chunk->starts = (uint32_t*) realloc(chunk->starts, startsCapacity * sizeof(uint32_t));
+    }
+    chunk->starts[chunk->tokens.count - 1] = position;
+    if (token->tokenType == TK_EOF)
+      break;
+  }
+  chunk->stop = currentOffset(chunk->lexer);
+  return NULL;
+}
+
+// Identifiers were interned in the chunk's private table; re-intern them in
+// stream order so ids come out exactly as sequential lexing assigns them
+void appendChunkTokens(KplCompiler *compiler, TokenStream *stream, LexChunk *chunk, int first, int *remap) {
+  Token token;
+  int i;
+
+  for (i = first; i < chunk->tokens.count; i++) {
+    token.tokenType = chunk->tokens.types[i];
+    token.offset = chunk->tokens.offsets[i];
+    token.value = chunk->tokens.values[i];
+    if (token.tokenType == TK_IDENT) {
+      if (remap[token.value] < 0)
+        remap[token.value] = internString(&compiler->internTable,
+                                          internedString(&chunk->lexer->internTable, token.value));
+      token.value = remap[token.value];
+    }
+    appendToken(stream, &token);
+  }
+}
+
+// Walks the chunks in order with the compiler's own reader, re-lexing
+// sequentially until the real position meets a chunk's token boundary.
+// The last chunk always runs to TK_EOF, so the merged stream does too.
+void mergeChunks(KplCompiler *compiler, TokenStream *stream, LexChunk *chunks, int chunkCount) {
+  int position = 0;
+  int done = 0;
+  int i, k;
+
+  for (i = 0; (i < chunkCount) && !done; i++) {
+    LexChunk *chunk = &chunks[i];
+    int chunkInterns = internCount(&chunk->lexer->internTable);
+    int *remap = (int*) malloc((chunkInterns + 1) * sizeof(int));
+
+    memset(remap, -1, (chunkInterns + 1) * sizeof(int));
+    k = 0;
+    while (1) {
+      Token *token;
+
+      while ((k < chunk->tokens.count) && (chunk->starts[k] < (uint32_t) position))
+        k ++;
+      if ((k < chunk->tokens.count) && (chunk->starts[k] == (uint32_t) position)) {
+        appendChunkTokens(compiler, stream, chunk, k, remap);
+        position = chunk->stop;
+        done = (stream->types[stream->count - 1] == TK_EOF);
+        break;
+      }
+      if (position >= chunk->end)
+        break;
+
+      seekInput(compiler, position);
+      token = getToken(compiler);
+      appendToken(stream, token);
+      position = currentOffset(compiler);
+      if (token->tokenType == TK_EOF) {
+        done = 1;
+        break;
+      }
+    }
+
+    free(remap);
+  }
+}
+
+// Lexes the whole input of the compiler's reader, like lexTokenStream()
+void lexTokenStreamParallel(KplCompiler *compiler, TokenStream *stream, int threadCount) {
+  LexChunk *chunks;
+  pthread_t *threads;
+  const char *text;
+  int length;
+  int chunkCount;
+  int i;
+
+  text = inputText(compiler, &length);
+  chunkCount = length / MIN_LEX_CHUNK;
+  if (chunkCount > threadCount)
+    chunkCount = threadCount;
+  if (chunkCount <= 1) {
+    lexTokenStream(compiler, stream);
+    return;
+  }
+
+  chunks = (LexChunk*) calloc(chunkCount, sizeof(LexChunk));
+  threads = (pthread_t*) malloc(chunkCount * sizeof(pthread_t));
+
+  // Boundaries are moved just past a newline, where a token is most likely to start
+  for (i = 0; i < chunkCount; i++) {
+    int start = (int) ((long long) length * i / chunkCount);
+    if (i > 0) {
+      const char *newline = memchr(text + start, '\n', length - start);
+      start = (newline == NULL) ? length : newline + 1 - text;
+      if (start < chunks[i - 1].start)
+        start = chunks[i - 1].start;
+    }
+    chunks[i].text = text;
+    chunks[i].length = length;
+    chunks[i].start = start;
+    if (i > 0)
+      chunks[i - 1].end = start;
+  }
+  chunks[chunkCount - 1].end = length + 1;
+
+  for (i = 0; i < chunkCount; i++)
+    pthread_create(&threads[i], NULL, lexChunk, &chunks[i]);
+  for (i = 0; i < chunkCount; i++)
+    pthread_join(threads[i], NULL);
+
+  mergeChunks(compiler, stream, chunks, chunkCount);
+
+  for (i = 0; i < chunkCount; i++) {
+    freeTokenStream(&chunks[i].tokens);
+    free(chunks[i].starts);
+    freeCompiler(chunks[i].lexer);
+  }
+  free(chunks);
+  free(threads);
+}
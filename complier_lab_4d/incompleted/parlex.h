@@ -0,0 +1,14 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __PARLEX_H__
+#define __PARLEX_H__
+
+#include "tokenstream.h"
+
+void lexTokenStreamParallel(KplCompiler *compiler, TokenStream *stream, int threadCount);
+
+#endif
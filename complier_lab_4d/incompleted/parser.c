@@ -5,838 +5,1103 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "reader.h"
 #include "scanner.h"
 #include "parser.h"
 #include "semantics.h"
 #include "error.h"
+#include "intern.h"
+#include "tokenstream.h"
+#include "parlex.h"
+#include "tokencache.h"
 #include "debug.h"
+#include "ast.h"
+#include "compiler.h"
+
+// Synchronisation sets for panic-mode recovery, each ended by TK_NONE.
+// They are the FOLLOW sets of the constructs the parser recovers in.
+TokenType followExpression[] = {
+  KW_TO, KW_DO, SB_RPAR, SB_COMMA, SB_EQ, SB_NEQ, SB_LE, SB_LT, SB_GE, SB_GT,
+  SB_RSEL, SB_SEMICOLON, KW_END, KW_ELSE, KW_THEN, TK_NONE
+};
+TokenType followTerm[] = {
+  SB_PLUS, SB_MINUS,
+  KW_TO, KW_DO, SB_RPAR, SB_COMMA, SB_EQ, SB_NEQ, SB_LE, SB_LT, SB_GE, SB_GT,
+  SB_RSEL, SB_SEMICOLON, KW_END, KW_ELSE, KW_THEN, TK_NONE
+};
+TokenType followFactor[] = {
+  SB_TIMES, SB_SLASH, SB_PLUS, SB_MINUS,
+  KW_TO, KW_DO, SB_RPAR, SB_COMMA, SB_EQ, SB_NEQ, SB_LE, SB_LT, SB_GE, SB_GT,
+  SB_RSEL, SB_SEMICOLON, KW_END, KW_ELSE, KW_THEN, TK_NONE
+};
+TokenType followStatement[] = {SB_SEMICOLON, KW_END, KW_ELSE, TK_NONE};
+// Statement lists resume at the next statement or at the END of the list
+TokenType syncStatements[] = {SB_SEMICOLON, KW_END, TK_NONE};
+// Constants and types end a declaration or a parameter
+TokenType followDeclaration[] = {
+  SB_SEMICOLON, SB_RPAR, KW_CONST, KW_VAR, KW_TYPE, KW_FUNCTION, KW_PROCEDURE, KW_BEGIN, TK_NONE
+};
+// Declaration lists resume after the next ';', or at the next section or body
+TokenType syncDeclarations[] = {
+  SB_SEMICOLON, KW_CONST, KW_TYPE, KW_VAR, KW_FUNCTION, KW_PROCEDURE, KW_BEGIN, TK_NONE
+};
+TokenType declarationSections[] = {KW_CONST, KW_TYPE, KW_VAR, TK_NONE};
+
+Token* nextToken(KplCompiler *compiler) {
+  if (compiler->tokenStream == NULL)
+    return getValidToken(compiler);
+
+  while ((compiler->streamPos < compiler->tokenStream->count) && (compiler->tokenStream->types[compiler->streamPos] == TK_NONE)) {
+    error(compiler, compiler->tokenStream->values[compiler->streamPos], compiler->tokenStream->offsets[compiler->streamPos]);
+    compiler->streamPos ++;
+  }
+  return streamToken(compiler, compiler->tokenStream, compiler->streamPos++);
+}
+
+void scan(KplCompiler *compiler) {
+  compiler->currentToken = compiler->lookAhead;
+  compiler->lookAhead = nextToken(compiler);
+}
+
+void eat(KplCompiler *compiler, TokenType tokenType) {
+  if (compiler->lookAhead->tokenType == tokenType) {
+    scan(compiler);
+  } else {
+    missingToken(compiler, tokenType, compiler->lookAhead->offset);
+    // Carry on as if the token had been there
+    compiler->insertedToken.offset = compiler->lookAhead->offset;
+    compiler->insertedToken.tokenType = tokenType;
+    compiler->insertedToken.value = (tokenType == TK_IDENT) ? internString(&compiler->internTable, "?") : 0;
+    compiler->currentToken = &compiler->insertedToken;
+  }
+}
 
-Token *currentToken;
-Token *lookAhead;
+int inSet(TokenType tokenType, TokenType *set) {
+  for (; *set != TK_NONE; set ++)
+    if (*set == tokenType)
+      return 1;
+  return 0;
+}
 
-extern Type* intType;
-extern Type* charType;
-extern SymTab* symtab;
+// Panic mode: drops tokens until one that may follow the broken construct
+void skipTo(KplCompiler *compiler, TokenType *set) {
+  while ((compiler->lookAhead->tokenType != TK_EOF) && !inSet(compiler->lookAhead->tokenType, set))
+    scan(compiler);
+}
 
-void scan(void) {
-  Token* tmp = currentToken;
-  currentToken = lookAhead;
-  lookAhead = getValidToken();
-  free(tmp);
+// Ends a constant, type or variable declaration. If it had errors, the rest
+// of it is dropped; its ';' is then eaten quietly if it is there at all.
+void endDeclaration(KplCompiler *compiler, int errorCount) {
+  if (compiler->errorCount == errorCount) {
+    eat(compiler, SB_SEMICOLON);
+    return;
+  }
+  skipTo(compiler, syncDeclarations);
+  if (compiler->lookAhead->tokenType == SB_SEMICOLON)
+    scan(compiler);
+  else // recovery ends here, so a complaint about this token is a cascade
+    compiler->lastErrorOffset = compiler->lookAhead->offset;
 }
 
-void eat(TokenType tokenType) {
-  if (lookAhead->tokenType == tokenType) {
-    scan();
-  } else missingToken(tokenType, lookAhead->lineNo, lookAhead->colNo);
+// Drops the parenthesised arguments of a name that could not be resolved
+void skipArguments(KplCompiler *compiler) {
+  int depth = 0;
+
+  do {
+    if (compiler->lookAhead->tokenType == SB_LPAR)
+      depth ++;
+    else if (compiler->lookAhead->tokenType == SB_RPAR)
+      depth --;
+    else if ((compiler->lookAhead->tokenType == TK_EOF) || inSet(compiler->lookAhead->tokenType, followStatement))
+      break;
+    scan(compiler);
+  } while (depth > 0);
 }
 
-void compileProgram(void) {
+void compileProgram(KplCompiler *compiler) {
   Object* program;
 
-  eat(KW_PROGRAM);
-  eat(TK_IDENT);
+  eat(compiler, KW_PROGRAM);
+  eat(compiler, TK_IDENT);
 
-  program = createProgramObject(currentToken->string);
-  enterBlock(program->progAttrs->scope);
+  program = createProgramObject(compiler, compiler->currentToken->value);
+  enterBlock(compiler, program->progAttrs.scope);
 
-  eat(SB_SEMICOLON);
+  eat(compiler, SB_SEMICOLON);
 
-  compileBlock();
-  eat(SB_PERIOD);
+  compileBlock(compiler);
+  eat(compiler, SB_PERIOD);
 
-  exitBlock();
+  exitBlock(compiler);
 }
 
-void compileBlock(void) {
+void compileBlock(KplCompiler *compiler) {
   Object* constObj;
   ConstantValue* constValue;
+  int errorCount;
 
-  if (lookAhead->tokenType == KW_CONST) {
-    eat(KW_CONST);
+  if (compiler->lookAhead->tokenType == KW_CONST) {
+    eat(compiler, KW_CONST);
 
     do {
-      eat(TK_IDENT);
+      errorCount = compiler->errorCount;
+      eat(compiler, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      constObj = createConstantObject(currentToken->string);
+      checkFreshIdent(compiler, compiler->currentToken->value);
+      constObj = createConstantObject(compiler, compiler->currentToken->value);
       
-      eat(SB_EQ);
-      constValue = compileConstant();
+      eat(compiler, SB_EQ);
+      constValue = compileConstant(compiler);
       
-      constObj->constAttrs->value = constValue;
-      declareObject(constObj);
+      constObj->constAttrs.value = constValue;
+      declareObject(compiler, constObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      endDeclaration(compiler, errorCount);
+    } while (compiler->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock2();
+    compileBlock2(compiler);
   } 
-  else compileBlock2();
+  else compileBlock2(compiler);
 }
 
-void compileBlock2(void) {
+void compileBlock2(KplCompiler *compiler) {
   Object* typeObj;
   Type* actualType;
+  int errorCount;
 
-  if (lookAhead->tokenType == KW_TYPE) {
-    eat(KW_TYPE);
+  if (compiler->lookAhead->tokenType == KW_TYPE) {
+    eat(compiler, KW_TYPE);
 
     do {
-      eat(TK_IDENT);
+      errorCount = compiler->errorCount;
+      eat(compiler, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      typeObj = createTypeObject(currentToken->string);
+      checkFreshIdent(compiler, compiler->currentToken->value);
+      typeObj = createTypeObject(compiler, compiler->currentToken->value);
       
-      eat(SB_EQ);
-      actualType = compileType();
+      eat(compiler, SB_EQ);
+      actualType = compileType(compiler);
       
-      typeObj->typeAttrs->actualType = actualType;
-      declareObject(typeObj);
+      typeObj->typeAttrs.actualType = actualType;
+      declareObject(compiler, typeObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      endDeclaration(compiler, errorCount);
+    } while (compiler->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock3();
+    compileBlock3(compiler);
   } 
-  else compileBlock3();
+  else compileBlock3(compiler);
 }
 
-void compileBlock3(void) {
+void compileBlock3(KplCompiler *compiler) {
   Object* varObj;
   Type* varType;
+  int errorCount;
 
-  if (lookAhead->tokenType == KW_VAR) {
-    eat(KW_VAR);
+  if (compiler->lookAhead->tokenType == KW_VAR) {
+    eat(compiler, KW_VAR);
 
     do {
-      eat(TK_IDENT);
+      errorCount = compiler->errorCount;
+      eat(compiler, TK_IDENT);
       
-      checkFreshIdent(currentToken->string);
-      varObj = createVariableObject(currentToken->string);
+      checkFreshIdent(compiler, compiler->currentToken->value);
+      varObj = createVariableObject(compiler, compiler->currentToken->value);
 
-      eat(SB_COLON);
-      varType = compileType();
+      eat(compiler, SB_COLON);
+      varType = compileType(compiler);
       
-      varObj->varAttrs->type = varType;
-      declareObject(varObj);
+      varObj->varAttrs.type = varType;
+      declareObject(compiler, varObj);
       
-      eat(SB_SEMICOLON);
-    } while (lookAhead->tokenType == TK_IDENT);
+      endDeclaration(compiler, errorCount);
+    } while (compiler->lookAhead->tokenType == TK_IDENT);
 
-    compileBlock4();
+    compileBlock4(compiler);
   } 
-  else compileBlock4();
+  else compileBlock4(compiler);
 }
 
-void compileBlock4(void) {
-  compileSubDecls();
-  compileBlock5();
+void compileBlock4(KplCompiler *compiler) {
+  compileSubDecls(compiler);
+  // A section out of order, where recovery may also stop, is reported and
+  // then compiled with the declarations after it
+  if (inSet(compiler->lookAhead->tokenType, declarationSections)) {
+    missingToken(compiler, KW_BEGIN, compiler->lookAhead->offset);
+    compileBlock(compiler);
+  } else compileBlock5(compiler);
 }
 
-void compileBlock5(void) {
-  eat(KW_BEGIN);
-  compileStatements();
-  eat(KW_END);
+void compileBlock5(KplCompiler *compiler) {
+  NodeId body;
+
+  eat(compiler, KW_BEGIN);
+  body = compileStatements(compiler);
+  eat(compiler, KW_END);
+  newRoutine(compiler, compiler->symtab->currentScope->owner, body);
 }
 
-void compileSubDecls(void) {
-  while ((lookAhead->tokenType == KW_FUNCTION) || (lookAhead->tokenType == KW_PROCEDURE)) {
-    if (lookAhead->tokenType == KW_FUNCTION)
-      compileFuncDecl();
-    else compileProcDecl();
+void compileSubDecls(KplCompiler *compiler) {
+  while ((compiler->lookAhead->tokenType == KW_FUNCTION) || (compiler->lookAhead->tokenType == KW_PROCEDURE)) {
+    if (compiler->lookAhead->tokenType == KW_FUNCTION)
+      compileFuncDecl(compiler);
+    else compileProcDecl(compiler);
   }
 }
 
-void compileFuncDecl(void) {
+void compileFuncDecl(KplCompiler *compiler) {
   Object* funcObj;
   Type* returnType;
 
-  eat(KW_FUNCTION);
-  eat(TK_IDENT);
+  eat(compiler, KW_FUNCTION);
+  eat(compiler, TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  funcObj = createFunctionObject(currentToken->string);
-  declareObject(funcObj);
+  checkFreshIdent(compiler, compiler->currentToken->value);
+  funcObj = createFunctionObject(compiler, compiler->currentToken->value);
+  declareObject(compiler, funcObj);
 
-  enterBlock(funcObj->funcAttrs->scope);
+  enterBlock(compiler, funcObj->funcAttrs.scope);
   
-  compileParams();
+  compileParams(compiler);
 
-  eat(SB_COLON);
-  returnType = compileBasicType();
-  funcObj->funcAttrs->returnType = returnType;
+  eat(compiler, SB_COLON);
+  returnType = compileBasicType(compiler);
+  funcObj->funcAttrs.returnType = returnType;
 
-  eat(SB_SEMICOLON);
-  compileBlock();
-  eat(SB_SEMICOLON);
+  eat(compiler, SB_SEMICOLON);
+  compileBlock(compiler);
+  eat(compiler, SB_SEMICOLON);
 
-  exitBlock();
+  exitBlock(compiler);
 }
 
-void compileProcDecl(void) {
+void compileProcDecl(KplCompiler *compiler) {
   Object* procObj;
 
-  eat(KW_PROCEDURE);
-  eat(TK_IDENT);
+  eat(compiler, KW_PROCEDURE);
+  eat(compiler, TK_IDENT);
 
-  checkFreshIdent(currentToken->string);
-  procObj = createProcedureObject(currentToken->string);
-  declareObject(procObj);
+  checkFreshIdent(compiler, compiler->currentToken->value);
+  procObj = createProcedureObject(compiler, compiler->currentToken->value);
+  declareObject(compiler, procObj);
 
-  enterBlock(procObj->procAttrs->scope);
+  enterBlock(compiler, procObj->procAttrs.scope);
 
-  compileParams();
+  compileParams(compiler);
 
-  eat(SB_SEMICOLON);
-  compileBlock();
-  eat(SB_SEMICOLON);
+  eat(compiler, SB_SEMICOLON);
+  compileBlock(compiler);
+  eat(compiler, SB_SEMICOLON);
 
-  exitBlock();
+  exitBlock(compiler);
 }
 
-ConstantValue* compileUnsignedConstant(void) {
+ConstantValue* compileUnsignedConstant(KplCompiler *compiler) {
   ConstantValue* constValue;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
+    eat(compiler, TK_NUMBER);
+    constValue = makeIntConstant(compiler, compiler->currentToken->value);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
+    eat(compiler, TK_IDENT);
 
-    obj = checkDeclaredConstant(currentToken->string);
-    constValue = duplicateConstantValue(obj->constAttrs->value);
+    obj = checkDeclaredConstant(compiler, compiler->currentToken->value);
+    constValue = (obj != NULL) ? duplicateConstantValue(compiler, obj->constAttrs.value) : NULL;
 
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
+    eat(compiler, TK_CHAR);
+    constValue = makeCharConstant(compiler, compiler->currentToken->value);
     break;
   default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_CONSTANT, compiler->lookAhead->offset);
+    skipTo(compiler, followDeclaration);
+    constValue = NULL;
     break;
   }
   return constValue;
 }
 
-ConstantValue* compileConstant(void) {
+ConstantValue* compileConstant(KplCompiler *compiler) {
   ConstantValue* constValue;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case SB_PLUS:
-    eat(SB_PLUS);
-    constValue = compileConstant2();
+    eat(compiler, SB_PLUS);
+    constValue = compileConstant2(compiler);
     break;
   case SB_MINUS:
-    eat(SB_MINUS);
-    constValue = compileConstant2();
-    constValue->intValue = - constValue->intValue;
+    eat(compiler, SB_MINUS);
+    constValue = compileConstant2(compiler);
+    if (constValue != NULL)
+      constValue->intValue = - constValue->intValue;
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    constValue = makeCharConstant(currentToken->string[0]);
+    eat(compiler, TK_CHAR);
+    constValue = makeCharConstant(compiler, compiler->currentToken->value);
     break;
   default:
-    constValue = compileConstant2();
+    constValue = compileConstant2(compiler);
     break;
   }
   return constValue;
 }
 
-ConstantValue* compileConstant2(void) {
+ConstantValue* compileConstant2(KplCompiler *compiler) {
   ConstantValue* constValue;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    constValue = makeIntConstant(currentToken->value);
+    eat(compiler, TK_NUMBER);
+    constValue = makeIntConstant(compiler, compiler->currentToken->value);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
-    obj = checkDeclaredConstant(currentToken->string);
-    if (obj->constAttrs->value->type == TP_INT)
-      constValue = duplicateConstantValue(obj->constAttrs->value);
-    else
-      error(ERR_UNDECLARED_INT_CONSTANT,currentToken->lineNo, currentToken->colNo);
+    eat(compiler, TK_IDENT);
+    obj = checkDeclaredConstant(compiler, compiler->currentToken->value);
+    if ((obj == NULL) || (obj->constAttrs.value == NULL))
+      constValue = NULL;
+    else if (obj->constAttrs.value->type == TP_INT)
+      constValue = duplicateConstantValue(compiler, obj->constAttrs.value);
+    else {
+      error(compiler, ERR_UNDECLARED_INT_CONSTANT,compiler->currentToken->offset);
+      constValue = NULL;
+    }
     break;
   default:
-    error(ERR_INVALID_CONSTANT, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_CONSTANT, compiler->lookAhead->offset);
+    skipTo(compiler, followDeclaration);
+    constValue = NULL;
     break;
   }
   return constValue;
 }
 
-Type* compileType(void) {
+Type* compileType(KplCompiler *compiler) {
   Type* type;
   Type* elementType;
-  int arraySize;
+  int arraySize, sizeOffset, elementSize;
   Object* obj;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case KW_INTEGER: 
-    eat(KW_INTEGER);
-    type =  makeIntType();
+    eat(compiler, KW_INTEGER);
+    type =  makeIntType(compiler);
     break;
   case KW_CHAR: 
-    eat(KW_CHAR); 
-    type = makeCharType();
+    eat(compiler, KW_CHAR); 
+    type = makeCharType(compiler);
     break;
   case KW_ARRAY:
-    eat(KW_ARRAY);
-    eat(SB_LSEL);
-    eat(TK_NUMBER);
-
-    arraySize = currentToken->value;
-
-    eat(SB_RSEL);
-    eat(KW_OF);
-    elementType = compileType();
-    type = makeArrayType(arraySize, elementType);
+    eat(compiler, KW_ARRAY);
+    eat(compiler, SB_LSEL);
+    if (compiler->lookAhead->tokenType != TK_NUMBER) {
+      // Without its size the array is an unknown type; the declaration resyncs
+      eat(compiler, TK_NUMBER);
+      type = NULL;
+      break;
+    }
+    eat(compiler, TK_NUMBER);
+
+    arraySize = compiler->currentToken->value;
+    sizeOffset = compiler->currentToken->offset;
+
+    eat(compiler, SB_RSEL);
+    eat(compiler, KW_OF);
+    elementType = compileType(compiler);
+    // Sizes are counted in words and must fit in an int
+    elementSize = sizeOfType(elementType);
+    if ((elementSize > 0) && (arraySize > INT_MAX / elementSize)) {
+      error(compiler, ERR_ARRAY_TOO_LARGE, sizeOffset);
+      type = NULL;
+      break;
+    }
+    type = makeArrayType(compiler, arraySize, elementType);
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
-    obj = checkDeclaredType(currentToken->string);
-    type = duplicateType(obj->typeAttrs->actualType);
+    eat(compiler, TK_IDENT);
+    obj = checkDeclaredType(compiler, compiler->currentToken->value);
+    type = (obj != NULL) ? obj->typeAttrs.actualType : NULL;
     break;
   default:
-    error(ERR_INVALID_TYPE, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_TYPE, compiler->lookAhead->offset);
+    skipTo(compiler, followDeclaration);
+    type = NULL;
     break;
   }
   return type;
 }
 
-Type* compileBasicType(void) {
+Type* compileBasicType(KplCompiler *compiler) {
   Type* type;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case KW_INTEGER: 
-    eat(KW_INTEGER); 
-    type = makeIntType();
+    eat(compiler, KW_INTEGER); 
+    type = makeIntType(compiler);
     break;
   case KW_CHAR: 
-    eat(KW_CHAR); 
-    type = makeCharType();
+    eat(compiler, KW_CHAR); 
+    type = makeCharType(compiler);
     break;
   default:
-    error(ERR_INVALID_BASICTYPE, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_BASICTYPE, compiler->lookAhead->offset);
+    skipTo(compiler, followDeclaration);
+    type = NULL;
     break;
   }
   return type;
 }
 
-void compileParams(void) {
-  if (lookAhead->tokenType == SB_LPAR) {
-    eat(SB_LPAR);
-    compileParam();
-    while (lookAhead->tokenType == SB_SEMICOLON) {
-      eat(SB_SEMICOLON);
-      compileParam();
+void compileParams(KplCompiler *compiler) {
+  if (compiler->lookAhead->tokenType == SB_LPAR) {
+    eat(compiler, SB_LPAR);
+    compileParam(compiler);
+    while (compiler->lookAhead->tokenType == SB_SEMICOLON) {
+      eat(compiler, SB_SEMICOLON);
+      compileParam(compiler);
     }
-    eat(SB_RPAR);
+    eat(compiler, SB_RPAR);
   }
 }
 
-void compileParam(void) {
+void compileParam(KplCompiler *compiler) {
   Object* param;
   Type* type;
   enum ParamKind paramKind;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case TK_IDENT:
     paramKind = PARAM_VALUE;
     break;
   case KW_VAR:
-    eat(KW_VAR);
+    eat(compiler, KW_VAR);
     paramKind = PARAM_REFERENCE;
     break;
   default:
-    error(ERR_INVALID_PARAMETER, lookAhead->lineNo, lookAhead->colNo);
-    break;
+    error(compiler, ERR_INVALID_PARAMETER, compiler->lookAhead->offset);
+    skipTo(compiler, followDeclaration);
+    return;
   }
 
-  eat(TK_IDENT);
-  checkFreshIdent(currentToken->string);
-  param = createParameterObject(currentToken->string, paramKind, symtab->currentScope->owner);
-  eat(SB_COLON);
-  type = compileBasicType();
-  param->paramAttrs->type = type;
-  declareObject(param);
+  eat(compiler, TK_IDENT);
+  checkFreshIdent(compiler, compiler->currentToken->value);
+  param = createParameterObject(compiler, compiler->currentToken->value, paramKind, compiler->symtab->currentScope->owner);
+  eat(compiler, SB_COLON);
+  type = compileBasicType(compiler);
+  param->paramAttrs.type = type;
+  declareObject(compiler, param);
 }
 
-void compileStatements(void) {
-  compileStatement();
-  while (lookAhead->tokenType == SB_SEMICOLON) {
-    eat(SB_SEMICOLON);
-    compileStatement();
+NodeId compileStatements(KplCompiler *compiler) {
+  NodeId first, last, st;
+
+  first = last = NO_NODE;
+  while (1) {
+    st = compileStatement(compiler);
+    // Empty statements leave no node
+    if (st != NO_NODE) {
+      if (last == NO_NODE)
+        first = st;
+      else stmtNode(compiler, last)->next = st;
+      last = st;
+    }
+
+    // Anything else is junk after a statement: report it where END was due
+    if ((compiler->lookAhead->tokenType != SB_SEMICOLON) && (compiler->lookAhead->tokenType != KW_END)) {
+      missingToken(compiler, KW_END, compiler->lookAhead->offset);
+      skipTo(compiler, syncStatements);
+    }
+    if (compiler->lookAhead->tokenType != SB_SEMICOLON)
+      break;
+    eat(compiler, SB_SEMICOLON);
   }
+  return first;
 }
 
-void compileStatement(void) {
-  switch (lookAhead->tokenType) {
+NodeId compileStatement(KplCompiler *compiler) {
+  switch (compiler->lookAhead->tokenType) {
   case TK_IDENT:
-    compileAssignSt();
-    break;
+    return compileAssignSt(compiler);
   case KW_CALL:
-    compileCallSt();
-    break;
+    return compileCallSt(compiler);
   case KW_BEGIN:
-    compileGroupSt();
-    break;
+    return compileGroupSt(compiler);
   case KW_IF:
-    compileIfSt();
-    break;
+    return compileIfSt(compiler);
   case KW_WHILE:
-    compileWhileSt();
-    break;
+    return compileWhileSt(compiler);
   case KW_FOR:
-    compileForSt();
-    break;
+    return compileForSt(compiler);
     // EmptySt needs to check FOLLOW tokens
-  case SB_SEMICOLON:
-  case KW_END:
-  case KW_ELSE:
+  default:
+    if (!inSet(compiler->lookAhead->tokenType, followStatement))
+      error(compiler, ERR_INVALID_STATEMENT, compiler->lookAhead->offset);
+    return NO_NODE;
+  }
+}
+
+// Variables, parameters and function results are resolved to the frame that
+// holds them, counted in static links from the current one, and a slot in it
+NodeId newStorageExpr(KplCompiler *compiler, ExprKind kind, Object* obj, Type* type) {
+  NodeId node = newExpr(compiler, kind, compiler->currentToken->offset, type);
+  ExprNode* expr = exprNode(compiler, node);
+  Scope* scope;
+
+  switch (obj->kind) {
+  case OBJ_VARIABLE:
+    scope = obj->varAttrs.scope;
+    expr->frameOffset = obj->varAttrs.localOffset;
+    break;
+  case OBJ_PARAMETER:
+    scope = obj->paramAttrs.scope;
+    expr->frameOffset = obj->paramAttrs.localOffset;
     break;
-    // Error occurs
   default:
-    error(ERR_INVALID_STATEMENT, lookAhead->lineNo, lookAhead->colNo);
+    scope = obj->funcAttrs.scope;
+    expr->frameOffset = RETURN_VALUE_OFFSET;
     break;
   }
+  expr->object = obj;
+  expr->depth = compiler->symtab->currentScope->level - scope->level;
+  return node;
 }
 
-Type* compileLValue(void) {
-  // TODO: parse a lvalue (a variable, an array element, a parameter, the current function identifier)
+NodeId compileLValue(KplCompiler *compiler) {
   Object* var;
-  Type* varType;
+  NodeId lvalue;
 
-  eat(TK_IDENT);
+  eat(compiler, TK_IDENT);
   // check if the identifier is a function identifier, or a variable identifier, or a parameter  
-  var = checkDeclaredLValueIdent(currentToken->string);
+  var = checkDeclaredLValueIdent(compiler, compiler->currentToken->value);
+  if (var == NULL)
+    return compileIndexes(compiler, NO_NODE);
   
   switch (var->kind) {
   case OBJ_VARIABLE:
-    varType = var->varAttrs->type;
-    varType = compileIndexes(varType);
+    lvalue = newStorageExpr(compiler, EXP_VARIABLE, var, var->varAttrs.type);
+    lvalue = compileIndexes(compiler, lvalue);
     break;
   case OBJ_PARAMETER:
-    varType = var->paramAttrs->type;
+    lvalue = newStorageExpr(compiler, EXP_PARAMETER, var, var->paramAttrs.type);
     break;
   case OBJ_FUNCTION:
-    varType = var->funcAttrs->returnType;
+    lvalue = newStorageExpr(compiler, EXP_FUNCTION, var, var->funcAttrs.returnType);
     break;
   default:
+    lvalue = NO_NODE;
     break;
   }
 
-  return varType;
+  return lvalue;
 }
 
-void compileAssignSt(void) {
-  // TODO: parse the assignment and check type consistency
-  Type* lvalueType;
-  Type* expType;
+NodeId compileAssignSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
+  NodeId target, expr, st;
   
-  lvalueType = compileLValue();
-  eat(SB_ASSIGN);
-  expType = compileExpression();
+  target = compileLValue(compiler);
+  eat(compiler, SB_ASSIGN);
+  expr = compileExpression(compiler);
   
-  checkTypeEquality(lvalueType, expType);
+  checkTypeEquality(compiler, exprType(compiler, target), exprType(compiler, expr));
+
+  st = newStmt(compiler, ST_ASSIGN, offset);
+  stmtNode(compiler, st)->target = target;
+  stmtNode(compiler, st)->expr = expr;
+  return st;
 }
 
-void compileCallSt(void) {
+NodeId compileCallSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
   Object* proc;
+  NodeId args, st;
 
-  eat(KW_CALL);
-  eat(TK_IDENT);
+  eat(compiler, KW_CALL);
+  eat(compiler, TK_IDENT);
 
-  proc = checkDeclaredProcedure(currentToken->string);
+  proc = checkDeclaredProcedure(compiler, compiler->currentToken->value);
+
+  if (proc != NULL)
+    args = compileArguments(compiler, proc->procAttrs.paramList);
+  else {
+    if (compiler->lookAhead->tokenType == SB_LPAR)
+      skipArguments(compiler);
+    args = NO_NODE;
+  }
 
-  compileArguments(proc->procAttrs->paramList);
+  st = newStmt(compiler, ST_CALL, offset);
+  stmtNode(compiler, st)->object = proc;
+  stmtNode(compiler, st)->expr = args;
+  return st;
 }
 
-void compileGroupSt(void) {
-  eat(KW_BEGIN);
-  compileStatements();
-  eat(KW_END);
+NodeId compileGroupSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
+  NodeId body, st;
+
+  eat(compiler, KW_BEGIN);
+  body = compileStatements(compiler);
+  eat(compiler, KW_END);
+
+  st = newStmt(compiler, ST_GROUP, offset);
+  stmtNode(compiler, st)->body = body;
+  return st;
 }
 
-void compileIfSt(void) {
-  eat(KW_IF);
-  compileCondition();
-  eat(KW_THEN);
-  compileStatement();
-  if (lookAhead->tokenType == KW_ELSE) 
-    compileElseSt();
+NodeId compileIfSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
+  NodeId condition, body, elseBody, st;
+
+  eat(compiler, KW_IF);
+  condition = compileCondition(compiler);
+  eat(compiler, KW_THEN);
+  body = compileStatement(compiler);
+  if (compiler->lookAhead->tokenType == KW_ELSE) 
+    elseBody = compileElseSt(compiler);
+  else elseBody = NO_NODE;
+
+  st = newStmt(compiler, ST_IF, offset);
+  stmtNode(compiler, st)->expr = condition;
+  stmtNode(compiler, st)->body = body;
+  stmtNode(compiler, st)->elseBody = elseBody;
+  return st;
 }
 
-void compileElseSt(void) {
-  eat(KW_ELSE);
-  compileStatement();
+NodeId compileElseSt(KplCompiler *compiler) {
+  eat(compiler, KW_ELSE);
+  return compileStatement(compiler);
 }
 
-void compileWhileSt(void) {
-  eat(KW_WHILE);
-  compileCondition();
-  eat(KW_DO);
-  compileStatement();
+NodeId compileWhileSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
+  NodeId condition, body, st;
+
+  eat(compiler, KW_WHILE);
+  condition = compileCondition(compiler);
+  eat(compiler, KW_DO);
+  body = compileStatement(compiler);
+
+  st = newStmt(compiler, ST_WHILE, offset);
+  stmtNode(compiler, st)->expr = condition;
+  stmtNode(compiler, st)->body = body;
+  return st;
 }
 
-void compileForSt(void) {
-  // TODO: Check type consistency of FOR's variable
+NodeId compileForSt(KplCompiler *compiler) {
+  int offset = compiler->lookAhead->offset;
   Object* var;
-  Type* type1;
-  Type* type2;
+  NodeId target = NO_NODE, start, limit, body, st;
   
-  eat(KW_FOR);
-  eat(TK_IDENT);
+  eat(compiler, KW_FOR);
+  eat(compiler, TK_IDENT);
 
   // check if the identifier is a variable
-  var = checkDeclaredVariable(currentToken->string);
-  checkIntType(var->varAttrs->type);
+  var = checkDeclaredVariable(compiler, compiler->currentToken->value);
+  if (var != NULL) {
+    checkIntType(compiler, var->varAttrs.type);
+    target = newStorageExpr(compiler, EXP_VARIABLE, var, var->varAttrs.type);
+  }
 
-  eat(SB_ASSIGN);
-  type1 = compileExpression();
-  checkIntType(type1);
+  eat(compiler, SB_ASSIGN);
+  start = compileExpression(compiler);
+  checkIntType(compiler, exprType(compiler, start));
 
-  eat(KW_TO);
-  type2 = compileExpression();
-  checkIntType(type2);
+  eat(compiler, KW_TO);
+  limit = compileExpression(compiler);
+  checkIntType(compiler, exprType(compiler, limit));
 
-  eat(KW_DO);
-  compileStatement();
+  eat(compiler, KW_DO);
+  body = compileStatement(compiler);
+
+  st = newStmt(compiler, ST_FOR, offset);
+  stmtNode(compiler, st)->object = var;
+  stmtNode(compiler, st)->target = target;
+  stmtNode(compiler, st)->expr = start;
+  stmtNode(compiler, st)->limit = limit;
+  stmtNode(compiler, st)->body = body;
+  return st;
 }
 
-void compileArgument(Object* param) {
-  // TODO: parse an argument, and check type consistency
-  //       If the corresponding parameter is a reference, the argument must be a lvalue
-  Type* argType;
+NodeId compileArgument(KplCompiler *compiler, Object* param) {
+  // If the corresponding parameter is a reference, the argument must be a lvalue
+  NodeId arg;
   
-  if (param->paramAttrs->kind == PARAM_VALUE) {
-    argType = compileExpression();
+  // Arguments past the end of the parameter list are parsed but not checked
+  if ((param == NULL) || (param->paramAttrs.kind == PARAM_VALUE)) {
+    arg = compileExpression(compiler);
   } else {
-    argType = compileLValue();
+    arg = compileLValue(compiler);
   }
   
-  checkTypeEquality(argType, param->paramAttrs->type);
+  if (param != NULL)
+    checkTypeEquality(compiler, exprType(compiler, arg), param->paramAttrs.type);
+  return arg;
 }
 
-void compileArguments(ObjectNode* paramList) {
-  //TODO: parse a list of arguments, check the consistency of the arguments and the given parameters
+NodeId compileArguments(KplCompiler *compiler, ObjectNode* paramList) {
   ObjectNode* node = paramList;
+  NodeId first = NO_NODE;
+  NodeId last = NO_NODE;
+  NodeId arg;
+  int tooMany = 0;
   
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case SB_LPAR:
-    eat(SB_LPAR);
-    if (node == NULL)
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-    compileArgument(node->object);
-    node = node->next;
-
-    while (lookAhead->tokenType == SB_COMMA) {
-      eat(SB_COMMA);
-      if (node == NULL)
-        error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-      compileArgument(node->object);
-      node = node->next;
+    eat(compiler, SB_LPAR);
+    while (1) {
+      // Reported once, at the first argument too many
+      if ((node == NULL) && !tooMany) {
+        error(compiler, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, compiler->currentToken->offset);
+        tooMany = 1;
+      }
+      arg = compileArgument(compiler, (node != NULL) ? node->object : NULL);
+      if (node != NULL)
+        node = node->next;
+
+      if (arg != NO_NODE) {
+        if (last == NO_NODE)
+          first = arg;
+        else exprNode(compiler, last)->next = arg;
+        last = arg;
+      }
+      if (compiler->lookAhead->tokenType != SB_COMMA)
+        break;
+      eat(compiler, SB_COMMA);
     }
     
     if (node != NULL)
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+      error(compiler, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, compiler->currentToken->offset);
     
-    eat(SB_RPAR);
+    eat(compiler, SB_RPAR);
     break;
     // Check FOLLOW set 
-  case SB_TIMES:
-  case SB_SLASH:
-  case SB_PLUS:
-  case SB_MINUS:
-  case KW_TO:
-  case KW_DO:
-  case SB_RPAR:
-  case SB_COMMA:
-  case SB_EQ:
-  case SB_NEQ:
-  case SB_LE:
-  case SB_LT:
-  case SB_GE:
-  case SB_GT:
-  case SB_RSEL:
-  case SB_SEMICOLON:
-  case KW_END:
-  case KW_ELSE:
-  case KW_THEN:
-    if (node != NULL)
-      error(ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
-    break;
   default:
-    error(ERR_INVALID_ARGUMENTS, lookAhead->lineNo, lookAhead->colNo);
+    if (inSet(compiler->lookAhead->tokenType, followFactor)) {
+      if (node != NULL)
+        error(compiler, ERR_PARAMETERS_ARGUMENTS_INCONSISTENCY, compiler->currentToken->offset);
+    } else {
+      error(compiler, ERR_INVALID_ARGUMENTS, compiler->lookAhead->offset);
+      skipTo(compiler, followFactor);
+    }
   }
+  return first;
 }
 
-void compileCondition(void) {
-  // TODO: check the type consistency of LHS and RSH, check the basic type
-  Type* type1;
-  Type* type2;
+NodeId compileCondition(KplCompiler *compiler) {
+  NodeId left, right, condition;
+  ExprKind kind;
+  int offset;
   
-  type1 = compileExpression();
-  checkBasicType(type1);
+  left = compileExpression(compiler);
+  checkBasicType(compiler, exprType(compiler, left));
 
-  switch (lookAhead->tokenType) {
+  offset = compiler->lookAhead->offset;
+  switch (compiler->lookAhead->tokenType) {
   case SB_EQ:
-    eat(SB_EQ);
+    eat(compiler, SB_EQ);
+    kind = EXP_EQ;
     break;
   case SB_NEQ:
-    eat(SB_NEQ);
+    eat(compiler, SB_NEQ);
+    kind = EXP_NEQ;
     break;
   case SB_LE:
-    eat(SB_LE);
+    eat(compiler, SB_LE);
+    kind = EXP_LE;
     break;
   case SB_LT:
-    eat(SB_LT);
+    eat(compiler, SB_LT);
+    kind = EXP_LT;
     break;
   case SB_GE:
-    eat(SB_GE);
+    eat(compiler, SB_GE);
+    kind = EXP_GE;
     break;
   case SB_GT:
-    eat(SB_GT);
+    eat(compiler, SB_GT);
+    kind = EXP_GT;
     break;
   default:
-    error(ERR_INVALID_COMPARATOR, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_COMPARATOR, compiler->lookAhead->offset);
+    kind = EXP_EQ;
   }
 
-  type2 = compileExpression();
-  checkBasicType(type2);
-  checkTypeEquality(type1, type2);
+  right = compileExpression(compiler);
+  checkBasicType(compiler, exprType(compiler, right));
+  checkTypeEquality(compiler, exprType(compiler, left), exprType(compiler, right));
+
+  condition = newExpr(compiler, kind, offset, NULL);
+  exprNode(compiler, condition)->left = left;
+  exprNode(compiler, condition)->right = right;
+  return condition;
 }
 
-Type* compileExpression(void) {
-  Type* type;
+// Binary nodes take the type of their left operand, as the checks below expect
+NodeId makeBinary(KplCompiler *compiler, ExprKind kind, int offset, NodeId left, NodeId right) {
+  NodeId node = newExpr(compiler, kind, offset, exprType(compiler, left));
+  exprNode(compiler, node)->left = left;
+  exprNode(compiler, node)->right = right;
+  return node;
+}
+
+NodeId compileExpression(KplCompiler *compiler) {
+  NodeId expr;
+  int offset = compiler->lookAhead->offset;
   
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case SB_PLUS:
-    eat(SB_PLUS);
-    type = compileExpression2();
-    checkIntType(type);
+    eat(compiler, SB_PLUS);
+    expr = compileExpression2(compiler);
+    checkIntType(compiler, exprType(compiler, expr));
     break;
   case SB_MINUS:
-    eat(SB_MINUS);
-    type = compileExpression2();
-    checkIntType(type);
+    eat(compiler, SB_MINUS);
+    expr = compileExpression2(compiler);
+    checkIntType(compiler, exprType(compiler, expr));
+    expr = makeBinary(compiler, EXP_NEGATE, offset, expr, NO_NODE);
     break;
   default:
-    type = compileExpression2();
+    expr = compileExpression2(compiler);
   }
-  return type;
+  return expr;
 }
 
-Type* compileExpression2(void) {
-  Type* type1;
-  Type* type2;
+NodeId compileExpression2(KplCompiler *compiler) {
+  NodeId term, expr, first;
 
-  type1 = compileTerm();
-  type2 = compileExpression3();
-  if (type2 == NULL) return type1;
+  term = compileTerm(compiler);
+  expr = compileExpression3(compiler, term);
+  if (expr == term) return expr;
   else {
-    checkTypeEquality(type1,type2);
-    return type1;
+    // The first operand must agree with the one right after it
+    for (first = expr; exprNode(compiler, first)->left != term; first = exprNode(compiler, first)->left);
+    checkTypeEquality(compiler, exprType(compiler, term), exprType(compiler, exprNode(compiler, first)->right));
+    return expr;
   }
 }
 
 
-Type* compileExpression3(void) {
-  Type* type1;
-  Type* type2;
+// Folds the remaining "+ term" and "- term" into left. Each precedence
+// level is a loop, so a chain of any length takes constant stack depth.
+NodeId compileExpression3(KplCompiler *compiler, NodeId left) {
+  NodeId term;
+  ExprKind kind;
+  int offset;
+
+  while ((compiler->lookAhead->tokenType == SB_PLUS) || (compiler->lookAhead->tokenType == SB_MINUS)) {
+    kind = (compiler->lookAhead->tokenType == SB_PLUS) ? EXP_ADD : EXP_SUB;
+    offset = compiler->lookAhead->offset;
+    scan(compiler);
+    term = compileTerm(compiler);
+    checkIntType(compiler, exprType(compiler, term));
+    left = makeBinary(compiler, kind, offset, left, term);
+  }
 
-  switch (lookAhead->tokenType) {
-  case SB_PLUS:
-    eat(SB_PLUS);
-    type1 = compileTerm();
-    checkIntType(type1);
-    type2 = compileExpression3();
-    if (type2 != NULL)
-      checkIntType(type2);
-    return type1;
-    break;
-  case SB_MINUS:
-    eat(SB_MINUS);
-    type1 = compileTerm();
-    checkIntType(type1);
-    type2 = compileExpression3();
-    if (type2 != NULL)
-      checkIntType(type2);
-    return type1;
-    break;
-    // check the FOLLOW set
-  case KW_TO:
-  case KW_DO:
-  case SB_RPAR:
-  case SB_COMMA:
-  case SB_EQ:
-  case SB_NEQ:
-  case SB_LE:
-  case SB_LT:
-  case SB_GE:
-  case SB_GT:
-  case SB_RSEL:
-  case SB_SEMICOLON:
-  case KW_END:
-  case KW_ELSE:
-  case KW_THEN:
-    return NULL;
-    break;
-  default:
-    error(ERR_INVALID_EXPRESSION, lookAhead->lineNo, lookAhead->colNo);
-    return NULL;
+  // check the FOLLOW set
+  if (!inSet(compiler->lookAhead->tokenType, followExpression)) {
+    error(compiler, ERR_INVALID_EXPRESSION, compiler->lookAhead->offset);
+    skipTo(compiler, followExpression);
   }
+  return left;
 }
 
-Type* compileTerm(void) {
-  // TODO: check type of Term2
-  Type* type;
-
-  type = compileFactor();
-  compileTerm2();
+NodeId compileTerm(KplCompiler *compiler) {
+  NodeId factor;
 
-  return type;
+  factor = compileFactor(compiler);
+  return compileTerm2(compiler, factor);
 }
 
-void compileTerm2(void) {
-  // TODO: check type of term2
-  Type* type;
+// Folds the remaining "* factor" and "/ factor" into left, as a loop
+NodeId compileTerm2(KplCompiler *compiler, NodeId left) {
+  NodeId factor;
+  ExprKind kind;
+  int offset;
+
+  while ((compiler->lookAhead->tokenType == SB_TIMES) || (compiler->lookAhead->tokenType == SB_SLASH)) {
+    kind = (compiler->lookAhead->tokenType == SB_TIMES) ? EXP_MUL : EXP_DIV;
+    offset = compiler->lookAhead->offset;
+    scan(compiler);
+    factor = compileFactor(compiler);
+    checkIntType(compiler, exprType(compiler, factor));
+    left = makeBinary(compiler, kind, offset, left, factor);
+  }
 
-  switch (lookAhead->tokenType) {
-  case SB_TIMES:
-    eat(SB_TIMES);
-    type = compileFactor();
-    checkIntType(type);
-    compileTerm2();
-    break;
-  case SB_SLASH:
-    eat(SB_SLASH);
-    type = compileFactor();
-    checkIntType(type);
-    compileTerm2();
-    break;
-    // check the FOLLOW set
-  case SB_PLUS:
-  case SB_MINUS:
-  case KW_TO:
-  case KW_DO:
-  case SB_RPAR:
-  case SB_COMMA:
-  case SB_EQ:
-  case SB_NEQ:
-  case SB_LE:
-  case SB_LT:
-  case SB_GE:
-  case SB_GT:
-  case SB_RSEL:
-  case SB_SEMICOLON:
-  case KW_END:
-  case KW_ELSE:
-  case KW_THEN:
-    break;
-  default:
-    error(ERR_INVALID_TERM, lookAhead->lineNo, lookAhead->colNo);
+  // check the FOLLOW set
+  if (!inSet(compiler->lookAhead->tokenType, followTerm)) {
+    error(compiler, ERR_INVALID_TERM, compiler->lookAhead->offset);
+    skipTo(compiler, followTerm);
   }
+  return left;
 }
 
-Type* compileFactor(void) {
-  // TODO: parse a factor and return the factor's type
-
+NodeId compileFactor(KplCompiler *compiler) {
   Object* obj;
-  Type* type;
+  NodeId factor, args;
 
-  switch (lookAhead->tokenType) {
+  switch (compiler->lookAhead->tokenType) {
   case TK_NUMBER:
-    eat(TK_NUMBER);
-    type = makeIntType();
+    eat(compiler, TK_NUMBER);
+    factor = newExpr(compiler, EXP_NUMBER, compiler->currentToken->offset, makeIntType(compiler));
+    exprNode(compiler, factor)->value = compiler->currentToken->value;
     break;
   case TK_CHAR:
-    eat(TK_CHAR);
-    type = makeCharType();
+    eat(compiler, TK_CHAR);
+    factor = newExpr(compiler, EXP_CHAR, compiler->currentToken->offset, makeCharType(compiler));
+    exprNode(compiler, factor)->value = compiler->currentToken->value;
     break;
   case TK_IDENT:
-    eat(TK_IDENT);
+    eat(compiler, TK_IDENT);
     // check if the identifier is declared
-    obj = checkDeclaredIdent(currentToken->string);
+    obj = checkDeclaredIdent(compiler, compiler->currentToken->value);
+    if (obj == NULL) {
+      // Parse on past whatever follows the name, with an unknown type
+      if (compiler->lookAhead->tokenType == SB_LPAR)
+        skipArguments(compiler);
+      factor = compileIndexes(compiler, NO_NODE);
+      break;
+    }
 
     switch (obj->kind) {
     case OBJ_CONSTANT:
-      switch (obj->constAttrs->value->type) {
+      if (obj->constAttrs.value == NULL) {
+        factor = newExpr(compiler, EXP_CONSTANT, compiler->currentToken->offset, NULL);
+        exprNode(compiler, factor)->object = obj;
+        break;
+      }
+      switch (obj->constAttrs.value->type) {
       case TP_INT:
-        type = makeIntType();
+        factor = newExpr(compiler, EXP_CONSTANT, compiler->currentToken->offset, makeIntType(compiler));
         break;
       case TP_CHAR:
-        type = makeCharType();
+        factor = newExpr(compiler, EXP_CONSTANT, compiler->currentToken->offset, makeCharType(compiler));
         break;
       default:
+        factor = newExpr(compiler, EXP_CONSTANT, compiler->currentToken->offset, NULL);
         break;
       }
+      exprNode(compiler, factor)->object = obj;
       break;
     case OBJ_VARIABLE:
-      type = obj->varAttrs->type;
-      type = compileIndexes(type);
+      factor = newStorageExpr(compiler, EXP_VARIABLE, obj, obj->varAttrs.type);
+      factor = compileIndexes(compiler, factor);
       break;
     case OBJ_PARAMETER:
-      type = obj->paramAttrs->type;
+      factor = newStorageExpr(compiler, EXP_PARAMETER, obj, obj->paramAttrs.type);
       break;
     case OBJ_FUNCTION:
-      compileArguments(obj->funcAttrs->paramList);
-      type = obj->funcAttrs->returnType;
+      factor = newExpr(compiler, EXP_CALL, compiler->currentToken->offset, obj->funcAttrs.returnType);
+      exprNode(compiler, factor)->object = obj;
+      // The arguments may grow the pool, so the node is looked up afterwards
+      args = compileArguments(compiler, obj->funcAttrs.paramList);
+      exprNode(compiler, factor)->left = args;
       break;
     default: 
-      error(ERR_INVALID_FACTOR,currentToken->lineNo, currentToken->colNo);
+      error(compiler, ERR_INVALID_FACTOR,compiler->currentToken->offset);
+      factor = NO_NODE;
       break;
     }
     break;
   default:
-    error(ERR_INVALID_FACTOR, lookAhead->lineNo, lookAhead->colNo);
+    error(compiler, ERR_INVALID_FACTOR, compiler->lookAhead->offset);
+    skipTo(compiler, followFactor);
+    factor = NO_NODE;
   }
   
-  return type;
+  return factor;
 }
 
-Type* compileIndexes(Type* arrayType) {
-  // TODO: parse a sequence of indexes, check the consistency to the arrayType, and return the element type
-  Type* type = arrayType;
-  Type* indexType;
+NodeId compileIndexes(KplCompiler *compiler, NodeId array) {
+  Type* type = exprType(compiler, array);
+  NodeId index;
+  int offset;
   
-  while (lookAhead->tokenType == SB_LSEL) {
-    eat(SB_LSEL);
-    checkArrayType(type);
-    indexType = compileExpression();
-    checkIntType(indexType);
-    eat(SB_RSEL);
-    type = type->elementType;
+  while (compiler->lookAhead->tokenType == SB_LSEL) {
+    offset = compiler->lookAhead->offset;
+    eat(compiler, SB_LSEL);
+    checkArrayType(compiler, type);
+    index = compileExpression(compiler);
+    checkIntType(compiler, exprType(compiler, index));
+    eat(compiler, SB_RSEL);
+    // Indexing something that is not an array leaves the type unknown
+    type = ((type != NULL) && (type->typeClass == TP_ARRAY)) ? type->elementType : NULL;
+    array = makeBinary(compiler, EXP_INDEX, offset, array, index);
+    exprNode(compiler, array)->type = type;
   }
   
-  return type;
+  return array;
 }
 
-int compile(char *fileName) {
-  if (openInputStream(fileName) == IO_ERROR)
-    return IO_ERROR;
+void compileSource(KplCompiler *compiler) {
+  TokenStream stream;
+
+  if (compiler->pretokenize) {
+    initTokenStream(&stream);
+    if ((compiler->tokenCacheDir == NULL) || !loadTokenCache(compiler, compiler->tokenCacheDir, &stream)) {
+      if (compiler->lexThreads > 1)
+        lexTokenStreamParallel(compiler, &stream, compiler->lexThreads);
+      else lexTokenStream(compiler, &stream);
+      if (compiler->tokenCacheDir != NULL)
+        saveTokenCache(compiler, compiler->tokenCacheDir, &stream);
+    }
+    compiler->tokenStream = &stream;
+    compiler->streamPos = 0;
+  }
 
-  currentToken = NULL;
-  lookAhead = getValidToken();
+  clearErrors(compiler);
+  compiler->currentToken = NULL;
+  compiler->lookAhead = nextToken(compiler);
 
-  initSymTab();
+  initSymTab(compiler);
 
-  compileProgram();
+  compileProgram(compiler);
 
-  printObject(symtab->program,0);
+  if (compiler->errorCount == 0) {
+    printObject(compiler->output, compiler->symtab->program, 0);
+    if (compiler->dumpFrames)
+      printFrames(compiler);
+  }
+  resetAst(compiler);
 
-  cleanSymTab();
+  cleanSymTab(compiler);
+  resetInternTable(&compiler->internTable);
 
-  free(currentToken);
-  free(lookAhead);
-  closeInputStream();
+  if (compiler->tokenStream != NULL) {
+    freeTokenStream(compiler->tokenStream);
+    compiler->tokenStream = NULL;
+  }
+
+  closeInputStream(compiler);
+}
+
+int compile(KplCompiler *compiler, char *fileName) {
+  if (openInputStream(compiler, fileName) == IO_ERROR)
+    return IO_ERROR;
+
+  compileSource(compiler);
   return IO_SUCCESS;
+}
 
+int compileBuffer(KplCompiler *compiler, const char *data, size_t len) {
+  if (openInputBuffer(compiler, data, len) == IO_ERROR)
+    return IO_ERROR;
+
+  compileSource(compiler);
+  return IO_SUCCESS;
+}
+
+// Compiles text in place; text[length] must be SENTINEL_CHAR
+int compileView(KplCompiler *compiler, const char *text, int length) {
+  if ((text == NULL) || (length < 0) || (text[length] != SENTINEL_CHAR))
+    return IO_ERROR;
+
+  openInputView(compiler, text, length, 0);
+  compileSource(compiler);
+  return IO_SUCCESS;
 }
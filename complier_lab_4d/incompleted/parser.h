@@ -5,55 +5,63 @@
  */
 #ifndef __PARSER_H__
 #define __PARSER_H__
+#include <stddef.h>
 #include "token.h"
 #include "symtab.h"
+#include "ast.h"
 
-void scan(void);
-void eat(TokenType tokenType);
+Token* nextToken(KplCompiler *compiler);
+void scan(KplCompiler *compiler);
+void eat(KplCompiler *compiler, TokenType tokenType);
 
-void compileProgram(void);
-void compileBlock(void);
-void compileBlock2(void);
-void compileBlock3(void);
-void compileBlock4(void);
-void compileBlock5(void);
+void compileProgram(KplCompiler *compiler);
+void compileBlock(KplCompiler *compiler);
+void compileBlock2(KplCompiler *compiler);
+void compileBlock3(KplCompiler *compiler);
+void compileBlock4(KplCompiler *compiler);
+void compileBlock5(KplCompiler *compiler);
 void compileConstDecls(void);
 void compileConstDecl(void);
 void compileTypeDecls(void);
 void compileTypeDecl(void);
 void compileVarDecls(void);
 void compileVarDecl(void);
-void compileSubDecls(void);
-void compileFuncDecl(void);
-void compileProcDecl(void);
-ConstantValue* compileUnsignedConstant(void);
-ConstantValue* compileConstant(void);
-ConstantValue* compileConstant2(void);
-Type* compileType(void);
-Type* compileBasicType(void);
-void compileParams(void);
-void compileParam(void);
-void compileStatements(void);
-void compileStatement(void);
-Type* compileLValue(void);
-void compileAssignSt(void);
-void compileCallSt(void);
-void compileGroupSt(void);
-void compileIfSt(void);
-void compileElseSt(void);
-void compileWhileSt(void);
-void compileForSt(void);
-void compileArgument(Object* param);
-void compileArguments(ObjectNode* paramList);
-void compileCondition(void);
-Type* compileExpression(void);
-Type* compileExpression2(void);
-Type* compileExpression3(void);
-Type* compileTerm(void);
-void compileTerm2(void);
-Type* compileFactor(void);
-Type* compileIndexes(Type* arrayType);
+void compileSubDecls(KplCompiler *compiler);
+void compileFuncDecl(KplCompiler *compiler);
+void compileProcDecl(KplCompiler *compiler);
+ConstantValue* compileUnsignedConstant(KplCompiler *compiler);
+ConstantValue* compileConstant(KplCompiler *compiler);
+ConstantValue* compileConstant2(KplCompiler *compiler);
+Type* compileType(KplCompiler *compiler);
+Type* compileBasicType(KplCompiler *compiler);
+void compileParams(KplCompiler *compiler);
+void compileParam(KplCompiler *compiler);
+NodeId compileStatements(KplCompiler *compiler);
+NodeId compileStatement(KplCompiler *compiler);
+NodeId newStorageExpr(KplCompiler *compiler, ExprKind kind, Object* obj, Type* type);
+NodeId compileLValue(KplCompiler *compiler);
+NodeId compileAssignSt(KplCompiler *compiler);
+NodeId compileCallSt(KplCompiler *compiler);
+NodeId compileGroupSt(KplCompiler *compiler);
+NodeId compileIfSt(KplCompiler *compiler);
+NodeId compileElseSt(KplCompiler *compiler);
+NodeId compileWhileSt(KplCompiler *compiler);
+NodeId compileForSt(KplCompiler *compiler);
+NodeId compileArgument(KplCompiler *compiler, Object* param);
+NodeId compileArguments(KplCompiler *compiler, ObjectNode* paramList);
+NodeId compileCondition(KplCompiler *compiler);
+NodeId compileExpression(KplCompiler *compiler);
+NodeId compileExpression2(KplCompiler *compiler);
+NodeId compileExpression3(KplCompiler *compiler, NodeId left);
+NodeId compileTerm(KplCompiler *compiler);
+NodeId compileTerm2(KplCompiler *compiler, NodeId left);
+NodeId compileFactor(KplCompiler *compiler);
+NodeId compileIndexes(KplCompiler *compiler, NodeId array);
 
-int compile(char *fileName);
+void compileSource(KplCompiler *compiler);
+
+int compile(KplCompiler *compiler, char *fileName);
+int compileBuffer(KplCompiler *compiler, const char *data, size_t len);
+int compileView(KplCompiler *compiler, const char *text, int length);
 
 #endif
@@ -5,33 +5,341 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "reader.h"
+#include "charcode.h"
+#include "compiler.h"
 
-FILE *inputStream;
-int lineNo, colNo;
-int currentChar;
+#define READ_CHUNK_SIZE 65536
 
-int readChar(void) {
-  currentChar = getc(inputStream);
-  colNo ++;
-  if (currentChar == '\n') {
-    lineNo ++;
-    colNo = 0;
+extern CharCode charCodes[];
+
+// The buffer always ends with SENTINEL_CHAR; the scanner never reads past it
+int readChar(KplCompiler *compiler) {
+  compiler->currentChar = (unsigned char) *++compiler->inputPtr;
+  return compiler->currentChar;
+}
+
+int endOfInput(KplCompiler *compiler) {
+  return compiler->inputPtr >= compiler->inputEnd;
+}
+
+// Vector loops only load whole blocks inside [inputBuffer, inputEnd);
+// the scalar tails rely on the sentinel instead of a bounds check
+void readPastBlanks(KplCompiler *compiler) {
+  const char *p = compiler->inputPtr;
+
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i belowTab = _mm256_set1_epi8('\t' - 1);
+  const __m256i aboveCR = _mm256_set1_epi8('\r' + 1);
+
+  while (p + 32 <= compiler->inputEnd) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) p);
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                     _mm256_and_si256(_mm256_cmpgt_epi8(v, belowTab),
+                                                      _mm256_cmpgt_epi8(aboveCR, v)));
+    unsigned mask = ~(unsigned) _mm256_movemask_epi8(blank);
+    if (mask != 0) {
+      p += __builtin_ctz(mask);
+      break;
+    }
+    p += 32;
+  }
+#elif defined(__SSE2__)
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i belowTab = _mm_set1_epi8('\t' - 1);
+  const __m128i aboveCR = _mm_set1_epi8('\r' + 1);
+
+  while (p + 16 <= compiler->inputEnd) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                 _mm_and_si128(_mm_cmpgt_epi8(v, belowTab),
+                                               _mm_cmpgt_epi8(aboveCR, v)));
+    unsigned mask = ~(unsigned) _mm_movemask_epi8(blank) & 0xFFFF;
+    if (mask != 0) {
+      p += __builtin_ctz(mask);
+      break;
+    }
+    p += 16;
+  }
+#endif
+
+  while (charCodes[(unsigned char) *p] == CHAR_SPACE)
+    p ++;
+  compiler->inputPtr = p;
+  compiler->currentChar = (unsigned char) *p;
+}
+
+// Called just after "(*": finds the first ')' whose preceding '*' is not part
+// of the opener. Returns 0 and stops at the end of input when there is none.
+int readPastCommentEnd(KplCompiler *compiler) {
+  const char *p = compiler->inputPtr + 1;
+
+#if defined(__AVX2__)
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i rpar = _mm256_set1_epi8(')');
+
+  while (p + 32 <= compiler->inputEnd) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) p);
+    __m256i prev = _mm256_loadu_si256((const __m256i*) (p - 1));
+    unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v, rpar),
+                                                                     _mm256_cmpeq_epi8(prev, star)));
+    if (mask != 0) {
+      p += __builtin_ctz(mask);
+      goto found;
+    }
+    p += 32;
+  }
+#elif defined(__SSE2__)
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i rpar = _mm_set1_epi8(')');
+
+  while (p + 16 <= compiler->inputEnd) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+    __m128i prev = _mm_loadu_si128((const __m128i*) (p - 1));
+    unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v, rpar),
+                                                               _mm_cmpeq_epi8(prev, star)));
+    if (mask != 0) {
+      p += __builtin_ctz(mask);
+      goto found;
+    }
+    p += 16;
+  }
+#endif
+
+  for (; p < compiler->inputEnd; p ++)
+    if ((*p == ')') && (p[-1] == '*'))
+      goto found;
+
+  compiler->inputPtr = compiler->inputEnd;
+  compiler->currentChar = (unsigned char) *compiler->inputPtr;
+  return 0;
+
+ found:
+  compiler->inputPtr = p + 1;
+  compiler->currentChar = (unsigned char) *compiler->inputPtr;
+  return 1;
+}
+
+int currentOffset(KplCompiler *compiler) {
+  return compiler->inputPtr - compiler->inputBuffer;
+}
+
+void seekInput(KplCompiler *compiler, int offset) {
+  compiler->inputPtr = compiler->inputBuffer + offset;
+  compiler->currentChar = (unsigned char) *compiler->inputPtr;
+}
+
+const char *inputText(KplCompiler *compiler, int *length) {
+  *length = compiler->inputEnd - compiler->inputBuffer;
+  return compiler->inputBuffer;
+}
+
+static void buildLineStarts(KplCompiler *compiler) {
+  const char *p = compiler->inputBuffer;
+  int capacity = 64;
+
+  compiler->lineStarts = (int*) malloc(capacity * sizeof(int));
+  compiler->lineStarts[0] = 0;
+  compiler->lineCount = 1;
+  while ((p < compiler->inputEnd) && ((p = memchr(p, '\n', compiler->inputEnd - p)) != NULL)) {
+    p ++;
+    if (compiler->lineCount == capacity) {
+      capacity *= 2;
+      compiler->lineStarts = (int*) realloc(compiler->lineStarts, capacity * sizeof(int));
+    }
+    compiler->lineStarts[compiler->lineCount++] = p - compiler->inputBuffer;
   }
-  return currentChar;
 }
 
-int openInputStream(char *fileName) {
-  inputStream = fopen(fileName, "rt");
-  if (inputStream == NULL)
+// A newline is reported at column 0 of the following line, as the old per-character counter did
+void offsetToPosition(KplCompiler *compiler, int offset, int *lineNo, int *colNo) {
+  int lo = 0;
+  int hi;
+
+  if (compiler->lineStarts == NULL)
+    buildLineStarts(compiler);
+
+  hi = compiler->lineCount - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (compiler->lineStarts[mid] <= offset + 1)
+      lo = mid;
+    else hi = mid - 1;
+  }
+  *lineNo = lo + 1;
+  *colNo = offset + 1 - compiler->lineStarts[lo];
+}
+
+// Map a regular file straight into memory; the scanner walks it in place
+// The file is mapped over an anonymous reservation one byte longer, so the
+// byte after the last character is always a zero-filled sentinel
+static int mapInput(KplCompiler *compiler, int fd, size_t size) {
+  void *addr = mmap(NULL, size + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED)
+    return IO_ERROR;
+  if (mmap(addr, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(addr, size + 1);
     return IO_ERROR;
-  lineNo = 1;
-  colNo = 0;
-  readChar();
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  compiler->inputBuffer = (const char*) addr;
+  compiler->inputEnd = compiler->inputBuffer + size;
+  compiler->inputKind = INPUT_MAPPED;
+  return IO_SUCCESS;
+}
+
+// Pipes and other unmappable inputs are slurped with large block reads
+static int slurpInput(KplCompiler *compiler, int fd) {
+  size_t size = 0;
+  size_t capacity = READ_CHUNK_SIZE;
+  char *buffer = (char*) malloc(capacity);
+  ssize_t n;
+
+  if (buffer == NULL)
+    return IO_ERROR;
+  while ((n = read(fd, buffer + size, capacity - size)) != 0) {
+    if (n < 0) {
+      free(buffer);
+      return IO_ERROR;
+    }
+    size += n;
+    if (size + 1 >= capacity) {
+      char *grown = (char*) realloc(buffer, capacity * 2);
+      if (grown == NULL) {
+        free(buffer);
+        return IO_ERROR;
+      }
+      buffer = grown;
+      capacity *= 2;
+    }
+  }
+  buffer[size] = SENTINEL_CHAR;
+  compiler->inputBuffer = buffer;
+  compiler->inputEnd = buffer + size;
+  compiler->inputKind = INPUT_OWNED;
+  return IO_SUCCESS;
+}
+
+static void resetInput(KplCompiler *compiler) {
+  compiler->inputPtr = compiler->inputBuffer;
+  compiler->lineStarts = NULL;
+  compiler->lineCount = 0;
+  compiler->currentChar = (unsigned char) *compiler->inputPtr;
+}
+
+int openInputStream(KplCompiler *compiler, char *fileName) {
+  struct stat st;
+  int fd;
+  int status;
+
+  fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return IO_ERROR;
+
+  if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0))
+    status = mapInput(compiler, fd, st.st_size);
+  else status = IO_ERROR;
+  if (status == IO_ERROR)
+    status = slurpInput(compiler, fd);
+  close(fd);
+  if (status == IO_ERROR)
+    return IO_ERROR;
+
+  resetInput(compiler);
   return IO_SUCCESS;
 }
 
-void closeInputStream() {
-  fclose(inputStream);
+// data is copied once so that the sentinel can be appended; the caller keeps ownership
+int openInputBuffer(KplCompiler *compiler, const char *data, size_t len) {
+  char *buffer;
+
+  if ((data == NULL) && (len > 0))
+    return IO_ERROR;
+  buffer = (char*) malloc(len + 1);
+  if (buffer == NULL)
+    return IO_ERROR;
+  memcpy(buffer, data, len);
+  buffer[len] = SENTINEL_CHAR;
+  compiler->inputBuffer = buffer;
+  compiler->inputEnd = buffer + len;
+  compiler->inputKind = INPUT_OWNED;
+
+  resetInput(compiler);
+  return IO_SUCCESS;
+}
+
+// Reads text that another reader owns; text[length] must already be SENTINEL_CHAR
+void openInputView(KplCompiler *compiler, const char *text, int length, int offset) {
+  compiler->inputBuffer = text;
+  compiler->inputEnd = text + length;
+  compiler->inputKind = INPUT_VIEW;
+  resetInput(compiler);
+  seekInput(compiler, offset);
+}
+
+// Replaces deleted characters at offset with inserted ones. The result is
+// always an owned buffer, and reading restarts from the beginning.
+int spliceInput(KplCompiler *compiler, int offset, int deleted, const char *inserted, int insertedLength) {
+  int length = compiler->inputEnd - compiler->inputBuffer;
+  int tail = length - offset - deleted;
+  int newLength = length - deleted + insertedLength;
+  char *buffer;
+
+  if ((offset < 0) || (deleted < 0) || (insertedLength < 0) || (tail < 0))
+    return IO_ERROR;
+
+  if (compiler->inputKind == INPUT_OWNED) {
+    buffer = (char*) compiler->inputBuffer;
+    if (newLength > length) {
+      buffer = (char*) realloc(buffer, newLength + 1);
+      if (buffer == NULL)
+        return IO_ERROR;
+    }
+    memmove(buffer + offset + insertedLength, buffer + offset + deleted, tail);
+    free(compiler->lineStarts);
+  } else {
+    buffer = (char*) malloc(newLength + 1);
+    if (buffer == NULL)
+      return IO_ERROR;
+    memcpy(buffer, compiler->inputBuffer, offset);
+    memcpy(buffer + offset + insertedLength, compiler->inputBuffer + offset + deleted, tail);
+    closeInputStream(compiler);
+  }
+  memcpy(buffer + offset, inserted, insertedLength);
+  buffer[newLength] = SENTINEL_CHAR;
+  compiler->inputBuffer = buffer;
+  compiler->inputEnd = buffer + newLength;
+  compiler->inputKind = INPUT_OWNED;
+
+  resetInput(compiler);
+  return IO_SUCCESS;
+}
+
+void closeInputStream(KplCompiler *compiler) {
+  switch (compiler->inputKind) {
+  case INPUT_MAPPED:
+    munmap((void*) compiler->inputBuffer, compiler->inputEnd - compiler->inputBuffer + 1);
+    break;
+  case INPUT_OWNED:
+    free((void*) compiler->inputBuffer);
+    break;
+  case INPUT_VIEW:
+    break;
+  }
+  compiler->inputBuffer = compiler->inputEnd = compiler->inputPtr = NULL;
+  free(compiler->lineStarts);
+  compiler->lineStarts = NULL;
 }
 
@@ -7,11 +7,27 @@
 #ifndef __READER_H__
 #define __READER_H__
 
+#include <stddef.h>
+
 #define IO_ERROR 0
 #define IO_SUCCESS 1
 
-int readChar(void);
-int openInputStream(char *fileName);
-void closeInputStream(void);
+#define SENTINEL_CHAR '\0'
+
+typedef struct KplCompiler_ KplCompiler;
+
+int readChar(KplCompiler *compiler);
+int endOfInput(KplCompiler *compiler);
+void readPastBlanks(KplCompiler *compiler);
+int readPastCommentEnd(KplCompiler *compiler);
+int currentOffset(KplCompiler *compiler);
+void seekInput(KplCompiler *compiler, int offset);
+const char *inputText(KplCompiler *compiler, int *length);
+void offsetToPosition(KplCompiler *compiler, int offset, int *lineNo, int *colNo);
+int openInputStream(KplCompiler *compiler, char *fileName);
+int openInputBuffer(KplCompiler *compiler, const char *data, size_t len);
+void openInputView(KplCompiler *compiler, const char *text, int length, int offset);
+int spliceInput(KplCompiler *compiler, int offset, int deleted, const char *inserted, int insertedLength);
+void closeInputStream(KplCompiler *compiler);
 
 #endif
@@ -7,238 +7,160 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "reader.h"
 #include "charcode.h"
 #include "token.h"
 #include "error.h"
+#include "intern.h"
+#include "dfa.h"
 #include "scanner.h"
+#include "compiler.h"
 
 
-extern int lineNo;
-extern int colNo;
-extern int currentChar;
-
 extern CharCode charCodes[];
 
 /***************************************************************/
 
-void skipBlank() {
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_SPACE))
-    readChar();
+void skipBlank(KplCompiler *compiler) {
+  readPastBlanks(compiler);
 }
 
-void skipComment() {
-  int state = 0;
-  while ((currentChar != EOF) && (state < 2)) {
-    switch (charCodes[currentChar]) {
-    case CHAR_TIMES:
-      state = 1;
-      break;
-    case CHAR_RPAR:
-      if (state == 1) state = 2;
-      else state = 0;
-      break;
-    default:
-      state = 0;
-    }
-    readChar();
-  }
-  if (state != 2) 
-    error(ERR_END_OF_COMMENT, lineNo, colNo);
+int skipComment(KplCompiler *compiler) {
+  return readPastCommentEnd(compiler);
 }
 
-Token* readIdentKeyword(void) {
-  Token *token = makeToken(TK_NONE, lineNo, colNo);
-  int count = 1;
-
-  token->string[0] = toupper((char)currentChar);
-  readChar();
-
-  while ((currentChar != EOF) && 
-	 ((charCodes[currentChar] == CHAR_LETTER) || (charCodes[currentChar] == CHAR_DIGIT))) {
-    if (count <= MAX_IDENT_LEN) token->string[count++] = toupper((char)currentChar);
-    readChar();
-  }
-
-  if (count > MAX_IDENT_LEN) {
-    error(ERR_IDENT_TOO_LONG, token->lineNo, token->colNo);
-    return token;
-  }
-
-  token->string[count] = '\0';
-  token->tokenType = checkKeyword(token->string);
-
-  if (token->tokenType == TK_NONE)
-    token->tokenType = TK_IDENT;
-
+// Lexical errors are returned as TK_NONE tokens carrying the error code, and
+// are reported by whoever consumes the token
+Token* makeErrorToken(KplCompiler *compiler, ErrorCode err, int offset) {
+  Token *token = makeToken(compiler, TK_NONE, offset);
+  token->value = err;
   return token;
 }
 
-Token* readNumber(void) {
-  Token *token = makeToken(TK_NUMBER, lineNo, colNo);
-  int count = 0;
+// Identifiers are upper-cased, then either a keyword or interned
+void finishIdentKeyword(KplCompiler *compiler, Token *token, const char *lexeme, int length) {
+  int i;
 
-  while ((currentChar != EOF) && (charCodes[currentChar] == CHAR_DIGIT)) {
-    token->string[count++] = (char)currentChar;
-    readChar();
+  if (length + 1 > compiler->identCapacity) {
+    while (length + 1 > compiler->identCapacity)
+      compiler->identCapacity = (compiler->identCapacity == 0) ? 64 : compiler->identCapacity * 2;
+    compiler->identBuffer = (char*) realloc(compiler->identBuffer, compiler->identCapacity);
   }
+  // Only letters and digits get here, so upper-casing is a subtraction
+  for (i = 0; i < length; i++)
+    compiler->identBuffer[i] = (lexeme[i] >= 'a') ? lexeme[i] - ('a' - 'A') : lexeme[i];
+  compiler->identBuffer[length] = '\0';
 
-  token->string[count] = '\0';
-  token->value = atoi(token->string);
-  return token;
+  token->tokenType = checkKeyword(compiler->identBuffer);
+  if (token->tokenType == TK_NONE) {
+    token->tokenType = TK_IDENT;
+    token->value = internChars(&compiler->internTable, compiler->identBuffer, length);
+  }
 }
 
-Token* readConstChar(void) {
-  Token *token = makeToken(TK_CHAR, lineNo, colNo);
+// Returns 0 if the number does not fit in an int
+int finishNumber(Token *token, const char *lexeme, int length) {
+  unsigned int value = 0;
+  int i, digit;
 
-  readChar();
-  if (currentChar == EOF) {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
+  for (i = 0; i < length; i++) {
+    digit = lexeme[i] - '0';
+    if (value > (INT_MAX - digit) / 10)
+      return 0;
+    value = value * 10 + digit;
   }
-    
-  token->string[0] = currentChar;
-  token->string[1] = '\0';
+  token->value = value;
+  return 1;
+}
 
-  readChar();
-  if (currentChar == EOF) {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
-  }
+// Only tokens that carry a value need more than the DFA gives
+Token* acceptToken(KplCompiler *compiler, TokenType tokenType, const char *lexeme, int offset, int length) {
+  Token *token = makeToken(compiler, tokenType, offset);
 
-  if (charCodes[currentChar] == CHAR_SINGLEQUOTE) {
-    readChar();
-    return token;
-  } else {
-    token->tokenType = TK_NONE;
-    error(ERR_INVALID_CONSTANT_CHAR, token->lineNo, token->colNo);
-    return token;
+  switch (tokenType) {
+  case TK_IDENT: finishIdentKeyword(compiler, token, lexeme, length); break;
+  case TK_NUMBER:
+    if (!finishNumber(token, lexeme, length)) {
+      token->tokenType = TK_NONE;
+      token->value = ERR_NUMBER_TOO_LARGE;
+    }
+    break;
+  case TK_CHAR: token->value = (unsigned char) lexeme[1]; break;
+  default: break;
   }
+  return token;
 }
 
-Token* getToken(void) {
-  Token *token;
-  int ln, cn;
-
-  if (currentChar == EOF) 
-    return makeToken(TK_EOF, lineNo, colNo);
-
-  switch (charCodes[currentChar]) {
-  case CHAR_SPACE: skipBlank(); return getToken();
-  case CHAR_LETTER: return readIdentKeyword();
-  case CHAR_DIGIT: return readNumber();
-  case CHAR_PLUS: 
-    token = makeToken(SB_PLUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_MINUS:
-    token = makeToken(SB_MINUS, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_TIMES:
-    token = makeToken(SB_TIMES, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_SLASH:
-    token = makeToken(SB_SLASH, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_LT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_LE, ln, cn);
-    } else return makeToken(SB_LT, ln, cn);
-  case CHAR_GT:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_GE, ln, cn);
-    } else return makeToken(SB_GT, ln, cn);
-  case CHAR_EQ: 
-    token = makeToken(SB_EQ, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_EXCLAIMATION:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_NEQ, ln, cn);
-    } else {
-      token = makeToken(TK_NONE, ln, cn);
-      error(ERR_INVALID_SYMBOL, ln, cn);
-      return token;
+// Runs the DFA from scanner.spec until no transition is left, then acts on
+// the state it stopped in. Skipped blanks and comments restart the loop.
+Token* getToken(KplCompiler *compiler) {
+  const char *text;
+  const char *end;
+  const char *begin;
+  const char *p;
+  int length;
+  int state, next;
+
+  text = inputText(compiler, &length);
+  end = text + length;
+  p = text + currentOffset(compiler);
+
+  while (1) {
+    begin = p;
+    state = DFA_START;
+    // No state moves on the sentinel, so the loop needs no bounds check
+    while ((next = dfaNext[state][(unsigned char) *p]) != DFA_DEAD) {
+      state = next;
+      p ++;
     }
-  case CHAR_COMMA:
-    token = makeToken(SB_COMMA, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_PERIOD:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_RPAR)) {
-      readChar();
-      return makeToken(SB_RSEL, ln, cn);
-    } else return makeToken(SB_PERIOD, ln, cn);
-  case CHAR_SEMICOLON:
-    token = makeToken(SB_SEMICOLON, lineNo, colNo);
-    readChar(); 
-    return token;
-  case CHAR_COLON:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
-    if ((currentChar != EOF) && (charCodes[currentChar] == CHAR_EQ)) {
-      readChar();
-      return makeToken(SB_ASSIGN, ln, cn);
-    } else return makeToken(SB_COLON, ln, cn);
-  case CHAR_SINGLEQUOTE: return readConstChar();
-  case CHAR_LPAR:
-    ln = lineNo;
-    cn = colNo;
-    readChar();
 
-    if (currentChar == EOF) 
-      return makeToken(SB_LPAR, ln, cn);
-
-    switch (charCodes[currentChar]) {
-    case CHAR_PERIOD:
-      readChar();
-      return makeToken(SB_LSEL, ln, cn);
-    case CHAR_TIMES:
-      readChar();
-      skipComment();
-      return getToken();
-    default:
-      return makeToken(SB_LPAR, ln, cn);
+    switch (dfaStates[state].action) {
+    case DFA_ACCEPT:
+      seekInput(compiler, p - text);
+      return acceptToken(compiler, dfaStates[state].tokenType, begin, begin - text, p - begin);
+    case DFA_ERROR:
+      seekInput(compiler, p - text);
+      return makeErrorToken(compiler, dfaStates[state].error, begin - text);
+    case DFA_EOF:
+      // The start state stops only on the sentinel's class; a NUL in the text is a stray byte
+      if (p < end) {
+        seekInput(compiler, p + 1 - text);
+        return makeErrorToken(compiler, ERR_INVALID_SYMBOL, begin - text);
+      }
+      seekInput(compiler, p - text);
+      return makeToken(compiler, TK_EOF, begin - text);
+    case DFA_SKIP_BLANKS:
+      // Single blanks are the common case; longer runs go to the vector loop
+      if (charCodes[(unsigned char) *p] == CHAR_SPACE) {
+        seekInput(compiler, p - text);
+        skipBlank(compiler);
+        p = text + currentOffset(compiler);
+      }
+      break;
+    case DFA_SKIP_COMMENT:
+      seekInput(compiler, p - text);
+      if (!skipComment(compiler))
+        return makeErrorToken(compiler, ERR_END_OF_COMMENT, currentOffset(compiler));
+      p = text + currentOffset(compiler);
+      break;
     }
-  case CHAR_RPAR:
-    token = makeToken(SB_RPAR, lineNo, colNo);
-    readChar(); 
-    return token;
-  default:
-    token = makeToken(TK_NONE, lineNo, colNo);
-    error(ERR_INVALID_SYMBOL, lineNo, colNo);
-    readChar(); 
-    return token;
   }
 }
 
-Token* getValidToken(void) {
-  Token *token = getToken();
+void freeScanner(KplCompiler *compiler) {
+  free(compiler->identBuffer);
+  compiler->identBuffer = NULL;
+  compiler->identCapacity = 0;
+}
+
+Token* getValidToken(KplCompiler *compiler) {
+  Token *token = getToken(compiler);
   while (token->tokenType == TK_NONE) {
-    free(token);
-    token = getToken();
+    error(compiler, token->value, token->offset);
+    freeToken(compiler, token);
+    token = getToken(compiler);
   }
   return token;
 }
@@ -246,57 +168,59 @@ Token* getValidToken(void) {
 
 /******************************************************************/
 
-void printToken(Token *token) {
+void printToken(KplCompiler *compiler, Token *token) {
+  int lineNo, colNo;
 
-  printf("%d-%d:", token->lineNo, token->colNo);
+  offsetToPosition(compiler, token->offset, &lineNo, &colNo);
+  fprintf(compiler->output, "%d-%d:", lineNo, colNo);
 
   switch (token->tokenType) {
-  case TK_NONE: printf("TK_NONE\n"); break;
-  case TK_IDENT: printf("TK_IDENT(%s)\n", token->string); break;
-  case TK_NUMBER: printf("TK_NUMBER(%s)\n", token->string); break;
-  case TK_CHAR: printf("TK_CHAR(\'%s\')\n", token->string); break;
-  case TK_EOF: printf("TK_EOF\n"); break;
-
-  case KW_PROGRAM: printf("KW_PROGRAM\n"); break;
-  case KW_CONST: printf("KW_CONST\n"); break;
-  case KW_TYPE: printf("KW_TYPE\n"); break;
-  case KW_VAR: printf("KW_VAR\n"); break;
-  case KW_INTEGER: printf("KW_INTEGER\n"); break;
-  case KW_CHAR: printf("KW_CHAR\n"); break;
-  case KW_ARRAY: printf("KW_ARRAY\n"); break;
-  case KW_OF: printf("KW_OF\n"); break;
-  case KW_FUNCTION: printf("KW_FUNCTION\n"); break;
-  case KW_PROCEDURE: printf("KW_PROCEDURE\n"); break;
-  case KW_BEGIN: printf("KW_BEGIN\n"); break;
-  case KW_END: printf("KW_END\n"); break;
-  case KW_CALL: printf("KW_CALL\n"); break;
-  case KW_IF: printf("KW_IF\n"); break;
-  case KW_THEN: printf("KW_THEN\n"); break;
-  case KW_ELSE: printf("KW_ELSE\n"); break;
-  case KW_WHILE: printf("KW_WHILE\n"); break;
-  case KW_DO: printf("KW_DO\n"); break;
-  case KW_FOR: printf("KW_FOR\n"); break;
-  case KW_TO: printf("KW_TO\n"); break;
-
-  case SB_SEMICOLON: printf("SB_SEMICOLON\n"); break;
-  case SB_COLON: printf("SB_COLON\n"); break;
-  case SB_PERIOD: printf("SB_PERIOD\n"); break;
-  case SB_COMMA: printf("SB_COMMA\n"); break;
-  case SB_ASSIGN: printf("SB_ASSIGN\n"); break;
-  case SB_EQ: printf("SB_EQ\n"); break;
-  case SB_NEQ: printf("SB_NEQ\n"); break;
-  case SB_LT: printf("SB_LT\n"); break;
-  case SB_LE: printf("SB_LE\n"); break;
-  case SB_GT: printf("SB_GT\n"); break;
-  case SB_GE: printf("SB_GE\n"); break;
-  case SB_PLUS: printf("SB_PLUS\n"); break;
-  case SB_MINUS: printf("SB_MINUS\n"); break;
-  case SB_TIMES: printf("SB_TIMES\n"); break;
-  case SB_SLASH: printf("SB_SLASH\n"); break;
-  case SB_LPAR: printf("SB_LPAR\n"); break;
-  case SB_RPAR: printf("SB_RPAR\n"); break;
-  case SB_LSEL: printf("SB_LSEL\n"); break;
-  case SB_RSEL: printf("SB_RSEL\n"); break;
+  case TK_NONE: fprintf(compiler->output, "TK_NONE\n"); break;
+  case TK_IDENT: fprintf(compiler->output, "TK_IDENT(%s)\n", internedString(&compiler->internTable, token->value)); break;
+  case TK_NUMBER: fprintf(compiler->output, "TK_NUMBER(%d)\n", token->value); break;
+  case TK_CHAR: fprintf(compiler->output, "TK_CHAR(\'%c\')\n", token->value); break;
+  case TK_EOF: fprintf(compiler->output, "TK_EOF\n"); break;
+
+  case KW_PROGRAM: fprintf(compiler->output, "KW_PROGRAM\n"); break;
+  case KW_CONST: fprintf(compiler->output, "KW_CONST\n"); break;
+  case KW_TYPE: fprintf(compiler->output, "KW_TYPE\n"); break;
+  case KW_VAR: fprintf(compiler->output, "KW_VAR\n"); break;
+  case KW_INTEGER: fprintf(compiler->output, "KW_INTEGER\n"); break;
+  case KW_CHAR: fprintf(compiler->output, "KW_CHAR\n"); break;
+  case KW_ARRAY: fprintf(compiler->output, "KW_ARRAY\n"); break;
+  case KW_OF: fprintf(compiler->output, "KW_OF\n"); break;
+  case KW_FUNCTION: fprintf(compiler->output, "KW_FUNCTION\n"); break;
+  case KW_PROCEDURE: fprintf(compiler->output, "KW_PROCEDURE\n"); break;
+  case KW_BEGIN: fprintf(compiler->output, "KW_BEGIN\n"); break;
+  case KW_END: fprintf(compiler->output, "KW_END\n"); break;
+  case KW_CALL: fprintf(compiler->output, "KW_CALL\n"); break;
+  case KW_IF: fprintf(compiler->output, "KW_IF\n"); break;
+  case KW_THEN: fprintf(compiler->output, "KW_THEN\n"); break;
+  case KW_ELSE: fprintf(compiler->output, "KW_ELSE\n"); break;
+  case KW_WHILE: fprintf(compiler->output, "KW_WHILE\n"); break;
+  case KW_DO: fprintf(compiler->output, "KW_DO\n"); break;
+  case KW_FOR: fprintf(compiler->output, "KW_FOR\n"); break;
+  case KW_TO: fprintf(compiler->output, "KW_TO\n"); break;
+
+  case SB_SEMICOLON: fprintf(compiler->output, "SB_SEMICOLON\n"); break;
+  case SB_COLON: fprintf(compiler->output, "SB_COLON\n"); break;
+  case SB_PERIOD: fprintf(compiler->output, "SB_PERIOD\n"); break;
+  case SB_COMMA: fprintf(compiler->output, "SB_COMMA\n"); break;
+  case SB_ASSIGN: fprintf(compiler->output, "SB_ASSIGN\n"); break;
+  case SB_EQ: fprintf(compiler->output, "SB_EQ\n"); break;
+  case SB_NEQ: fprintf(compiler->output, "SB_NEQ\n"); break;
+  case SB_LT: fprintf(compiler->output, "SB_LT\n"); break;
+  case SB_LE: fprintf(compiler->output, "SB_LE\n"); break;
+  case SB_GT: fprintf(compiler->output, "SB_GT\n"); break;
+  case SB_GE: fprintf(compiler->output, "SB_GE\n"); break;
+  case SB_PLUS: fprintf(compiler->output, "SB_PLUS\n"); break;
+  case SB_MINUS: fprintf(compiler->output, "SB_MINUS\n"); break;
+  case SB_TIMES: fprintf(compiler->output, "SB_TIMES\n"); break;
+  case SB_SLASH: fprintf(compiler->output, "SB_SLASH\n"); break;
+  case SB_LPAR: fprintf(compiler->output, "SB_LPAR\n"); break;
+  case SB_RPAR: fprintf(compiler->output, "SB_RPAR\n"); break;
+  case SB_LSEL: fprintf(compiler->output, "SB_LSEL\n"); break;
+  case SB_RSEL: fprintf(compiler->output, "SB_RSEL\n"); break;
   }
 }
 
@@ -9,8 +9,9 @@
 
 #include "token.h"
 
-Token* getToken(void);
-Token* getValidToken(void);
-void printToken(Token *token);
+Token* getToken(KplCompiler *compiler);
+Token* getValidToken(KplCompiler *compiler);
+void printToken(KplCompiler *compiler, Token *token);
+void freeScanner(KplCompiler *compiler);
 
 #endif
@@ -0,0 +1,47 @@
+# KPL lexical spec, compiled into the scanner's DFA tables (dfa.c) by gendfa.
+#
+#   token <TokenType> <pattern> [else <ErrorCode>]
+#   skip  blanks|comment <pattern>
+#   error <ErrorCode> <pattern>
+#
+# A pattern is a sequence of character classes from charcode.h, written
+# without the CHAR_ prefix. a|b matches either class, ANY matches every
+# class, a-b matches a but not b, and a trailing * repeats the element. The scanner takes the longest
+# match without backtracking. When two rules are complete in the same state
+# the one listed first wins. "else" names the error reported when the input
+# stops in the middle of the rule.
+#
+# Keywords are scanned as TK_IDENT and picked out by checkKeyword().
+#
+# The sentinel after the input is END. gendfa rejects any rule that moves
+# on it, ANY included, so the scanner checks for the end of input only when
+# a token starts there.
+
+skip  blanks       SPACE
+skip  comment      LPAR TIMES
+
+token TK_IDENT     LETTER LETTER|DIGIT*
+token TK_NUMBER    DIGIT DIGIT*
+token TK_CHAR      SINGLEQUOTE ANY-END SINGLEQUOTE  else ERR_INVALID_CONSTANT_CHAR
+
+token SB_PLUS      PLUS
+token SB_MINUS     MINUS
+token SB_TIMES     TIMES
+token SB_SLASH     SLASH
+token SB_EQ        EQ
+token SB_COMMA     COMMA
+token SB_SEMICOLON SEMICOLON
+token SB_RPAR      RPAR
+token SB_LPAR      LPAR
+token SB_LSEL      LPAR PERIOD
+token SB_PERIOD    PERIOD
+token SB_RSEL      PERIOD RPAR
+token SB_COLON     COLON
+token SB_ASSIGN    COLON EQ
+token SB_LT        LT
+token SB_LE        LT EQ
+token SB_GT        GT
+token SB_GE        GT EQ
+token SB_NEQ       EXCLAIMATION EQ                  else ERR_INVALID_SYMBOL
+
+error ERR_INVALID_SYMBOL  UNKNOWN
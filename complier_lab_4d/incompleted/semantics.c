@@ -5,138 +5,151 @@
  */
 
 #include <stdlib.h>
-#include <string.h>
 #include "semantics.h"
 #include "error.h"
+#include "compiler.h"
 
-extern SymTab* symtab;
-extern Token* currentToken;
+// The check* functions return NULL after reporting an error, and a NULL type
+// stands for one that an earlier error left unknown; neither is reported again.
 
-Object* lookupObject(char *name) {
-  Scope* scope = symtab->currentScope;
+Object* lookupObject(KplCompiler *compiler, int nameId) {
+  Scope* scope = compiler->symtab->currentScope;
   Object* obj;
 
   while (scope != NULL) {
-    obj = findObject(scope->objList, name);
+    obj = findScopeObject(scope, nameId);
     if (obj != NULL) return obj;
     scope = scope->outer;
   }
-  obj = findObject(symtab->globalObjectList, name);
+  obj = findObject(compiler->symtab->globalObjectList, nameId);
   if (obj != NULL) return obj;
   return NULL;
 }
 
-void checkFreshIdent(char *name) {
-  if (findObject(symtab->currentScope->objList, name) != NULL)
-    error(ERR_DUPLICATE_IDENT, currentToken->lineNo, currentToken->colNo);
+void checkFreshIdent(KplCompiler *compiler, int nameId) {
+  if (findScopeObject(compiler->symtab->currentScope, nameId) != NULL)
+    error(compiler, ERR_DUPLICATE_IDENT, compiler->currentToken->offset);
 }
 
-Object* checkDeclaredIdent(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredIdent(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL) {
-    error(ERR_UNDECLARED_IDENT,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_IDENT,compiler->currentToken->offset);
   }
   return obj;
 }
 
-Object* checkDeclaredConstant(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredConstant(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL)
-    error(ERR_UNDECLARED_CONSTANT,currentToken->lineNo, currentToken->colNo);
-  if (obj->kind != OBJ_CONSTANT)
-    error(ERR_INVALID_CONSTANT,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_CONSTANT,compiler->currentToken->offset);
+  else if (obj->kind != OBJ_CONSTANT) {
+    error(compiler, ERR_INVALID_CONSTANT,compiler->currentToken->offset);
+    return NULL;
+  }
 
   return obj;
 }
 
-Object* checkDeclaredType(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredType(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL)
-    error(ERR_UNDECLARED_TYPE,currentToken->lineNo, currentToken->colNo);
-  if (obj->kind != OBJ_TYPE)
-    error(ERR_INVALID_TYPE,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_TYPE,compiler->currentToken->offset);
+  else if (obj->kind != OBJ_TYPE) {
+    error(compiler, ERR_INVALID_TYPE,compiler->currentToken->offset);
+    return NULL;
+  }
 
   return obj;
 }
 
-Object* checkDeclaredVariable(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredVariable(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL)
-    error(ERR_UNDECLARED_VARIABLE,currentToken->lineNo, currentToken->colNo);
-  if (obj->kind != OBJ_VARIABLE)
-    error(ERR_INVALID_VARIABLE,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_VARIABLE,compiler->currentToken->offset);
+  else if (obj->kind != OBJ_VARIABLE) {
+    error(compiler, ERR_INVALID_VARIABLE,compiler->currentToken->offset);
+    return NULL;
+  }
 
   return obj;
 }
 
-Object* checkDeclaredFunction(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredFunction(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL)
-    error(ERR_UNDECLARED_FUNCTION,currentToken->lineNo, currentToken->colNo);
-  if (obj->kind != OBJ_FUNCTION)
-    error(ERR_INVALID_FUNCTION,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_FUNCTION,compiler->currentToken->offset);
+  else if (obj->kind != OBJ_FUNCTION) {
+    error(compiler, ERR_INVALID_FUNCTION,compiler->currentToken->offset);
+    return NULL;
+  }
 
   return obj;
 }
 
-Object* checkDeclaredProcedure(char* name) {
-  Object* obj = lookupObject(name);
+Object* checkDeclaredProcedure(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
   if (obj == NULL)
-    error(ERR_UNDECLARED_PROCEDURE,currentToken->lineNo, currentToken->colNo);
-  if (obj->kind != OBJ_PROCEDURE)
-    error(ERR_INVALID_PROCEDURE,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_UNDECLARED_PROCEDURE,compiler->currentToken->offset);
+  else if (obj->kind != OBJ_PROCEDURE) {
+    error(compiler, ERR_INVALID_PROCEDURE,compiler->currentToken->offset);
+    return NULL;
+  }
 
   return obj;
 }
 
-Object* checkDeclaredLValueIdent(char* name) {
-  Object* obj = lookupObject(name);
-  if (obj == NULL)
-    error(ERR_UNDECLARED_IDENT,currentToken->lineNo, currentToken->colNo);
+Object* checkDeclaredLValueIdent(KplCompiler *compiler, int nameId) {
+  Object* obj = lookupObject(compiler, nameId);
+  if (obj == NULL) {
+    error(compiler, ERR_UNDECLARED_IDENT,compiler->currentToken->offset);
+    return NULL;
+  }
 
   switch (obj->kind) {
   case OBJ_VARIABLE:
   case OBJ_PARAMETER:
     break;
   case OBJ_FUNCTION:
-    if (obj != symtab->currentScope->owner) 
-      error(ERR_INVALID_IDENT,currentToken->lineNo, currentToken->colNo);
+    if (obj != compiler->symtab->currentScope->owner) 
+      error(compiler, ERR_INVALID_IDENT,compiler->currentToken->offset);
     break;
   default:
-    error(ERR_INVALID_IDENT,currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_INVALID_IDENT,compiler->currentToken->offset);
+    return NULL;
   }
 
   return obj;
 }
 
 // Kiểm tra xem type có phải là kiểu int không
-void checkIntType(Type* type) {
-  if (type->typeClass != TP_INT)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkIntType(KplCompiler *compiler, Type* type) {
+  if ((type != NULL) && (type->typeClass != TP_INT))
+    error(compiler, ERR_TYPE_INCONSISTENCY, compiler->currentToken->offset);
 }
 
 // Kiểm tra xem type có phải là kiểu char không
-void checkCharType(Type* type) {
-  if (type->typeClass != TP_CHAR)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkCharType(KplCompiler *compiler, Type* type) {
+  if ((type != NULL) && (type->typeClass != TP_CHAR))
+    error(compiler, ERR_TYPE_INCONSISTENCY, compiler->currentToken->offset);
 }
 
 // Kiểm tra xem type có phải là kiểu cơ bản (int/char) không
-void checkBasicType(Type* type) {
-  if ((type->typeClass != TP_INT) && (type->typeClass != TP_CHAR))
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkBasicType(KplCompiler *compiler, Type* type) {
+  if ((type != NULL) && (type->typeClass != TP_INT) && (type->typeClass != TP_CHAR))
+    error(compiler, ERR_TYPE_INCONSISTENCY, compiler->currentToken->offset);
 }
 
 // Kiểm tra xem type có phải là kiểu array không
-void checkArrayType(Type* type) {
-  if (type->typeClass != TP_ARRAY)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+void checkArrayType(KplCompiler *compiler, Type* type) {
+  if ((type != NULL) && (type->typeClass != TP_ARRAY))
+    error(compiler, ERR_TYPE_INCONSISTENCY, compiler->currentToken->offset);
 }
 
 // Kiểm tra xem hai type có bằng nhau không
-void checkTypeEquality(Type* type1, Type* type2) {
+void checkTypeEquality(KplCompiler *compiler, Type* type1, Type* type2) {
   if (compareType(type1, type2) == 0)
-    error(ERR_TYPE_INCONSISTENCY, currentToken->lineNo, currentToken->colNo);
+    error(compiler, ERR_TYPE_INCONSISTENCY, compiler->currentToken->offset);
 }
 
 
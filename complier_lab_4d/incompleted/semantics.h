@@ -9,19 +9,19 @@
 
 #include "symtab.h"
 
-void checkFreshIdent(char *name);
-Object* checkDeclaredIdent(char *name);
-Object* checkDeclaredConstant(char *name);
-Object* checkDeclaredType(char *name);
-Object* checkDeclaredVariable(char *name);
-Object* checkDeclaredFunction(char *name);
-Object* checkDeclaredProcedure(char *name);
-Object* checkDeclaredLValueIdent(char *name);
+void checkFreshIdent(KplCompiler *compiler, int nameId);
+Object* checkDeclaredIdent(KplCompiler *compiler, int nameId);
+Object* checkDeclaredConstant(KplCompiler *compiler, int nameId);
+Object* checkDeclaredType(KplCompiler *compiler, int nameId);
+Object* checkDeclaredVariable(KplCompiler *compiler, int nameId);
+Object* checkDeclaredFunction(KplCompiler *compiler, int nameId);
+Object* checkDeclaredProcedure(KplCompiler *compiler, int nameId);
+Object* checkDeclaredLValueIdent(KplCompiler *compiler, int nameId);
 
-void checkIntType(Type* type);
-void checkCharType(Type* type);
-void checkArrayType(Type* type);
-void checkBasicType(Type* type);
-void checkTypeEquality(Type* type1, Type* type2);
+void checkIntType(KplCompiler *compiler, Type* type);
+void checkCharType(KplCompiler *compiler, Type* type);
+void checkArrayType(KplCompiler *compiler, Type* type);
+void checkBasicType(KplCompiler *compiler, Type* type);
+void checkTypeEquality(KplCompiler *compiler, Type* type1, Type* type2);
 
 #endif
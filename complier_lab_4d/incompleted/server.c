@@ -0,0 +1,227 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "reader.h"
+#include "parser.h"
+#include "server.h"
+
+// Resources freed by other connections closing may let accept() work again
+#define ACCEPT_BACKOFF_USEC 100000
+
+// A connection compiles its requests one after another, so it keeps one
+// compiler and one request buffer and reuses their storage every time
+struct Connection_ {
+  KplCompiler *compiler;
+  char *source;
+  uint32_t sourceCapacity;
+  int in;
+  int out;
+};
+
+typedef struct Connection_ Connection;
+
+static int readFully(int fd, void *data, size_t size) {
+  char *p = (char*) data;
+  ssize_t n;
+
+  while (size > 0) {
+    if ((n = read(fd, p, size)) <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static int writeFully(int fd, const void *data, size_t size) {
+  const char *p = (const char*) data;
+  ssize_t n;
+
+  while (size > 0) {
+    if ((n = write(fd, p, size)) <= 0)
+      return 0;
+    p += n;
+    size -= n;
+  }
+  return 1;
+}
+
+static Connection *openConnection(KplCompiler *options, int in, int out) {
+  Connection *connection = (Connection*) calloc(1, sizeof(Connection));
+
+  connection->compiler = createCompiler();
+  copyOptions(connection->compiler, options);
+  connection->in = in;
+  connection->out = out;
+  return connection;
+}
+
+static void closeConnection(Connection *connection) {
+  freeCompiler(connection->compiler);
+  free(connection->source);
+  free(connection);
+}
+
+// Compiles one request; returns 0 once the connection is over
+static int serveRequest(Connection *connection) {
+  KplCompiler *compiler = connection->compiler;
+  uint32_t length, reply[2];
+  char *output = NULL;
+  size_t outputSize = 0;
+  int ok;
+
+  if (!readFully(connection->in, &length, sizeof(length)))
+    return 0;
+  length = ntohl(length);
+  if (length > MAX_REQUEST_SIZE)
+    return 0;
+  // The source is compiled where it lands, behind a sentinel
+  if (length + 1 > connection->sourceCapacity) {
+    free(connection->source);
+    connection->sourceCapacity = length + 1;
+    connection->source = (char*) malloc(connection->sourceCapacity);
+    if (connection->source == NULL) {
+      connection->sourceCapacity = 0;
+      return 0;
+    }
+  }
+  if (!readFully(connection->in, connection->source, length))
+    return 0;
+  connection->source[length] = SENTINEL_CHAR;
+
+  compiler->output = open_memstream(&output, &outputSize);
+  ok = (compileView(compiler, connection->source, length) == IO_SUCCESS);
+  fclose(compiler->output);
+
+  if (ok) {
+    reply[0] = htonl(compiler->errorCount);
+    reply[1] = htonl(outputSize);
+    ok = writeFully(connection->out, reply, sizeof(reply)) &&
+         writeFully(connection->out, output, outputSize);
+  }
+  free(output);
+  return ok;
+}
+
+int serveStdio(KplCompiler *options) {
+  Connection *connection = openConnection(options, STDIN_FILENO, STDOUT_FILENO);
+
+  signal(SIGPIPE, SIG_IGN);
+  while (serveRequest(connection))
+    ;
+  closeConnection(connection);
+  return 0;
+}
+
+static void *serveConnection(void *arg) {
+  Connection *connection = (Connection*) arg;
+
+  while (serveRequest(connection))
+    ;
+  close(connection->in);
+  closeConnection(connection);
+  return NULL;
+}
+
+// Tells a live server's socket, which accepts a connection, from a stale one
+// left by a server that is gone; returns 1, 0, or -1 with errno set
+static int socketInUse(struct sockaddr_un *address) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  int result;
+
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr*) address, sizeof(*address)) == 0)
+    result = 1;
+  else result = (errno == ECONNREFUSED) ? 0 : -1;
+  close(fd);
+  return result;
+}
+
+int serveSocket(KplCompiler *options, const char *path) {
+  struct sockaddr_un address;
+  struct stat status;
+  Connection *connection;
+  pthread_t thread;
+  int listener, fd;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "kplc: socket path too long: %s\n", path);
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  // Only a socket left by a server that is gone may be replaced
+  if (lstat(path, &status) == 0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      fprintf(stderr, "kplc: %s exists and is not a socket\n", path);
+      return -1;
+    }
+    switch (socketInUse(&address)) {
+    case 0:
+      unlink(path);
+      break;
+    case 1:
+      fprintf(stderr, "kplc: %s: address in use by another server\n", path);
+      return -1;
+    default:
+      perror("kplc");
+      return -1;
+    }
+  }
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((listener < 0) ||
+      (bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0) ||
+      (listen(listener, SOMAXCONN) != 0)) {
+    perror("kplc");
+    return -1;
+  }
+
+  // A client that hangs up early must not take the server down with it
+  signal(SIGPIPE, SIG_IGN);
+  while (1) {
+    if ((fd = accept(listener, NULL, NULL)) < 0) {
+      switch (errno) {
+      case EINTR:
+      case ECONNABORTED:
+        break;
+      case EMFILE:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+        usleep(ACCEPT_BACKOFF_USEC);
+        break;
+      default:
+        perror("kplc");
+        close(listener);
+        return -1;
+      }
+      continue;
+    }
+    connection = openConnection(options, fd, fd);
+    if (pthread_create(&thread, NULL, serveConnection, connection) != 0) {
+      close(fd);
+      closeConnection(connection);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
@@ -0,0 +1,29 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "compiler.h"
+
+// Requests larger than this close the connection
+#define MAX_REQUEST_SIZE (64 << 20)
+
+/*
+ * A request is a 4-byte length followed by that many bytes of KPL source.
+ * The reply is a 4-byte error count, a 4-byte length and that many bytes of
+ * output: the diagnostics, then the symbol table dump if there were no
+ * errors. Lengths and counts are unsigned and in network byte order. A
+ * connection carries any number of requests and ends when the client
+ * closes it.
+ */
+
+// Serves requests from stdin, replying on stdout, until stdin ends
+int serveStdio(KplCompiler *options);
+// Serves connections to a Unix domain socket at path, one thread each
+int serveSocket(KplCompiler *options, const char *path);
+
+#endif
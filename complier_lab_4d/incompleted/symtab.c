@@ -7,91 +7,123 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include "symtab.h"
+#include "intern.h"
 #include "error.h"
-
-void freeObject(Object* obj);
-void freeScope(Scope* scope);
-void freeObjectList(ObjectNode *objList);
-void freeReferenceList(ObjectNode *objList);
-
-SymTab* symtab;
-Type* intType;
-Type* charType;
+#include "compiler.h"
 
 /******************* Type utilities ******************************/
 
-Type* makeIntType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_INT;
+// Types are interned: int and char are singletons and each array type is
+// made once per (arraySize, elementType), so equal types are the same pointer
+
+static Type* newType(KplCompiler *compiler, enum TypeClass typeClass) {
+  Type* type = (Type*) arenaAlloc(&compiler->arena, sizeof(Type));
+  type->typeClass = typeClass;
+  type->arraySize = 0;
+  type->elementType = NULL;
   return type;
 }
 
-Type* makeCharType(void) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_CHAR;
-  return type;
+Type* makeIntType(KplCompiler *compiler) {
+  return compiler->intType;
 }
 
-Type* makeArrayType(int arraySize, Type* elementType) {
-  Type* type = (Type*) malloc(sizeof(Type));
-  type->typeClass = TP_ARRAY;
-  type->arraySize = arraySize;
-  type->elementType = elementType;
-  return type;
+Type* makeCharType(KplCompiler *compiler) {
+  return compiler->charType;
 }
 
-Type* duplicateType(Type* type) {
-  Type* resultType = (Type*) malloc(sizeof(Type));
-  resultType->typeClass = type->typeClass;
-  if (type->typeClass == TP_ARRAY) {
-    resultType->arraySize = type->arraySize;
-    resultType->elementType = duplicateType(type->elementType);
+static int arrayTypeSlot(SymTab *symtab, int arraySize, Type* elementType) {
+  unsigned mask = symtab->arrayTypeCapacity - 1;
+  unsigned slot = ((unsigned) arraySize * 2654435761u ^ (unsigned) ((uintptr_t) elementType >> 4) * 40503u) & mask;
+  Type* type;
+
+  while (((type = symtab->arrayTypes[slot]) != NULL) &&
+         ((type->arraySize != arraySize) || (type->elementType != elementType)))
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+static void growArrayTypes(KplCompiler *compiler) {
+  SymTab *symtab = compiler->symtab;
+  Type** old = symtab->arrayTypes;
+  int oldCapacity = symtab->arrayTypeCapacity;
+  int i;
+
+  symtab->arrayTypeCapacity = (oldCapacity == 0) ? 64 : oldCapacity * 2;
+  symtab->arrayTypes = (Type**) arenaAlloc(&compiler->arena, symtab->arrayTypeCapacity * sizeof(Type*));
+  memset(symtab->arrayTypes, 0, symtab->arrayTypeCapacity * sizeof(Type*));
+  for (i = 0; i < oldCapacity; i++)
+    if (old[i] != NULL)
+      symtab->arrayTypes[arrayTypeSlot(symtab, old[i]->arraySize, old[i]->elementType)] = old[i];
+}
+
+// An array of a type left unknown by an error is unknown too
+Type* makeArrayType(KplCompiler *compiler, int arraySize, Type* elementType) {
+  SymTab *symtab = compiler->symtab;
+  Type* type;
+  int slot;
+
+  if (elementType == NULL)
+    return NULL;
+  if (2 * (symtab->arrayTypeCount + 1) > symtab->arrayTypeCapacity)
+    growArrayTypes(compiler);
+  slot = arrayTypeSlot(symtab, arraySize, elementType);
+  if (symtab->arrayTypes[slot] == NULL) {
+    type = newType(compiler, TP_ARRAY);
+    type->arraySize = arraySize;
+    type->elementType = elementType;
+    symtab->arrayTypes[slot] = type;
+    symtab->arrayTypeCount ++;
   }
-  return resultType;
+  return symtab->arrayTypes[slot];
 }
 
+// A NULL type is one left unknown by an error; it matches anything
 int compareType(Type* type1, Type* type2) {
-  if (type1->typeClass == type2->typeClass) {
-    if (type1->typeClass == TP_ARRAY) {
-      if (type1->arraySize == type2->arraySize)
-	return compareType(type1->elementType, type2->elementType);
-      else return 0;
-    } else return 1;
-  } else return 0;
+  return (type1 == NULL) || (type2 == NULL) || (type1 == type2);
 }
 
-void freeType(Type* type) {
+// An unknown type still takes a word, so that every object has its own slot.
+// compileType() refuses arrays whose size does not fit in an int.
+int sizeOfType(Type* type) {
+  if (type == NULL)
+    return 1;
   switch (type->typeClass) {
   case TP_INT:
+    return INT_SIZE;
   case TP_CHAR:
-    free(type);
-    break;
+    return CHAR_SIZE;
   case TP_ARRAY:
-    freeType(type->elementType);
-    freeType(type);
-    break;
+    return type->arraySize * sizeOfType(type->elementType);
   }
+  return 0;
 }
 
 /******************* Constant utility ******************************/
 
-ConstantValue* makeIntConstant(int i) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+ConstantValue* makeIntConstant(KplCompiler *compiler, int i) {
+  ConstantValue* value = (ConstantValue*) arenaAlloc(&compiler->arena, sizeof(ConstantValue));
   value->type = TP_INT;
   value->intValue = i;
   return value;
 }
 
-ConstantValue* makeCharConstant(char ch) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+ConstantValue* makeCharConstant(KplCompiler *compiler, char ch) {
+  ConstantValue* value = (ConstantValue*) arenaAlloc(&compiler->arena, sizeof(ConstantValue));
   value->type = TP_CHAR;
   value->charValue = ch;
   return value;
 }
 
-ConstantValue* duplicateConstantValue(ConstantValue* v) {
-  ConstantValue* value = (ConstantValue*) malloc(sizeof(ConstantValue));
+ConstantValue* duplicateConstantValue(KplCompiler *compiler, ConstantValue* v) {
+  ConstantValue* value;
+
+  if (v == NULL)
+    return NULL;
+  value = (ConstantValue*) arenaAlloc(&compiler->arena, sizeof(ConstantValue));
   value->type = v->type;
   if (v->type == TP_INT) 
     value->intValue = v->intValue;
@@ -102,144 +134,89 @@ ConstantValue* duplicateConstantValue(ConstantValue* v) {
 
 /******************* Object utilities ******************************/
 
-Scope* createScope(Object* owner, Scope* outer) {
-  Scope* scope = (Scope*) malloc(sizeof(Scope));
+Scope* createScope(KplCompiler *compiler, Object* owner, Scope* outer) {
+  Scope* scope = (Scope*) arenaAlloc(&compiler->arena, sizeof(Scope));
   scope->objList = NULL;
+  scope->objTail = NULL;
+  scope->objCount = 0;
+  scope->index = NULL;
+  scope->indexCapacity = 0;
   scope->owner = owner;
   scope->outer = outer;
+  scope->level = (outer == NULL) ? 0 : outer->level + 1;
+  scope->frameSize = RESERVED_WORDS;
   return scope;
 }
 
-Object* createProgramObject(char *programName) {
-  Object* program = (Object*) malloc(sizeof(Object));
-  strcpy(program->name, programName);
+Object* createProgramObject(KplCompiler *compiler, int programNameId) {
+  Object* program = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  program->nameId = programNameId;
+  program->name = internedString(&compiler->internTable, programNameId);
   program->kind = OBJ_PROGRAM;
-  program->progAttrs = (ProgramAttributes*) malloc(sizeof(ProgramAttributes));
-  program->progAttrs->scope = createScope(program,NULL);
-  symtab->program = program;
+  program->progAttrs.scope = createScope(compiler, program,NULL);
+  compiler->symtab->program = program;
 
   return program;
 }
 
-Object* createConstantObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createConstantObject(KplCompiler *compiler, int nameId) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_CONSTANT;
-  obj->constAttrs = (ConstantAttributes*) malloc(sizeof(ConstantAttributes));
   return obj;
 }
 
-Object* createTypeObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createTypeObject(KplCompiler *compiler, int nameId) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_TYPE;
-  obj->typeAttrs = (TypeAttributes*) malloc(sizeof(TypeAttributes));
   return obj;
 }
 
-Object* createVariableObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createVariableObject(KplCompiler *compiler, int nameId) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_VARIABLE;
-  obj->varAttrs = (VariableAttributes*) malloc(sizeof(VariableAttributes));
-  obj->varAttrs->scope = symtab->currentScope;
+  obj->varAttrs.scope = compiler->symtab->currentScope;
   return obj;
 }
 
-Object* createFunctionObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createFunctionObject(KplCompiler *compiler, int nameId) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_FUNCTION;
-  obj->funcAttrs = (FunctionAttributes*) malloc(sizeof(FunctionAttributes));
-  obj->funcAttrs->paramList = NULL;
-  obj->funcAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->funcAttrs.paramList = NULL;
+  obj->funcAttrs.scope = createScope(compiler, obj, compiler->symtab->currentScope);
   return obj;
 }
 
-Object* createProcedureObject(char *name) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createProcedureObject(KplCompiler *compiler, int nameId) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_PROCEDURE;
-  obj->procAttrs = (ProcedureAttributes*) malloc(sizeof(ProcedureAttributes));
-  obj->procAttrs->paramList = NULL;
-  obj->procAttrs->scope = createScope(obj, symtab->currentScope);
+  obj->procAttrs.paramList = NULL;
+  obj->procAttrs.scope = createScope(compiler, obj, compiler->symtab->currentScope);
   return obj;
 }
 
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner) {
-  Object* obj = (Object*) malloc(sizeof(Object));
-  strcpy(obj->name, name);
+Object* createParameterObject(KplCompiler *compiler, int nameId, enum ParamKind kind, Object* owner) {
+  Object* obj = (Object*) arenaAlloc(&compiler->arena, sizeof(Object));
+  obj->nameId = nameId;
+  obj->name = internedString(&compiler->internTable, nameId);
   obj->kind = OBJ_PARAMETER;
-  obj->paramAttrs = (ParameterAttributes*) malloc(sizeof(ParameterAttributes));
-  obj->paramAttrs->kind = kind;
-  obj->paramAttrs->function = owner;
+  obj->paramAttrs.kind = kind;
+  obj->paramAttrs.function = owner;
+  obj->paramAttrs.scope = (owner->kind == OBJ_FUNCTION) ? owner->funcAttrs.scope : owner->procAttrs.scope;
   return obj;
 }
 
-void freeObject(Object* obj) {
-  switch (obj->kind) {
-  case OBJ_CONSTANT:
-    free(obj->constAttrs->value);
-    free(obj->constAttrs);
-    break;
-  case OBJ_TYPE:
-    free(obj->typeAttrs->actualType);
-    free(obj->typeAttrs);
-    break;
-  case OBJ_VARIABLE:
-    free(obj->varAttrs->type);
-    free(obj->varAttrs);
-    break;
-  case OBJ_FUNCTION:
-    freeReferenceList(obj->funcAttrs->paramList);
-    freeType(obj->funcAttrs->returnType);
-    freeScope(obj->funcAttrs->scope);
-    free(obj->funcAttrs);
-    break;
-  case OBJ_PROCEDURE:
-    freeReferenceList(obj->procAttrs->paramList);
-    freeScope(obj->procAttrs->scope);
-    free(obj->procAttrs);
-    break;
-  case OBJ_PROGRAM:
-    freeScope(obj->progAttrs->scope);
-    free(obj->progAttrs);
-    break;
-  case OBJ_PARAMETER:
-    freeType(obj->paramAttrs->type);
-    free(obj->paramAttrs);
-  }
-  free(obj);
-}
-
-void freeScope(Scope* scope) {
-  freeObjectList(scope->objList);
-  free(scope);
-}
-
-void freeObjectList(ObjectNode *objList) {
-  ObjectNode* list = objList;
-
-  while (list != NULL) {
-    ObjectNode* node = list;
-    list = list->next;
-    freeObject(node->object);
-    free(node);
-  }
-}
-
-void freeReferenceList(ObjectNode *objList) {
-  ObjectNode* list = objList;
-
-  while (list != NULL) {
-    ObjectNode* node = list;
-    list = list->next;
-    free(node);
-  }
-}
-
-void addObject(ObjectNode **objList, Object* obj) {
-  ObjectNode* node = (ObjectNode*) malloc(sizeof(ObjectNode));
+void addObject(KplCompiler *compiler, ObjectNode **objList, Object* obj) {
+  ObjectNode* node = (ObjectNode*) arenaAlloc(&compiler->arena, sizeof(ObjectNode));
   node->object = obj;
   node->next = NULL;
   if ((*objList) == NULL) 
@@ -252,83 +229,165 @@ void addObject(ObjectNode **objList, Object* obj) {
   }
 }
 
-Object* findObject(ObjectNode *objList, char *name) {
+Object* findObject(ObjectNode *objList, int nameId) {
   while (objList != NULL) {
-    if (strcmp(objList->object->name, name) == 0) 
+    if (objList->object->nameId == nameId) 
       return objList->object;
     else objList = objList->next;
   }
   return NULL;
 }
 
-/******************* others ******************************/
+// Scopes smaller than this are searched along objList
+#define MIN_INDEXED_SCOPE 8
 
-void initSymTab(void) {
-  Object* obj;
-  Object* param;
+static int indexSlot(Scope *scope, int nameId) {
+  unsigned mask = scope->indexCapacity - 1;
+  unsigned slot = ((unsigned) nameId * 2654435761u) & mask;
 
-  symtab = (SymTab*) malloc(sizeof(SymTab));
-  symtab->globalObjectList = NULL;
-  
-  obj = createFunctionObject("READC");
-  obj->funcAttrs->returnType = makeCharType();
-  addObject(&(symtab->globalObjectList), obj);
+  while ((scope->index[slot] != NULL) && (scope->index[slot]->nameId != nameId))
+    slot = (slot + 1) & mask;
+  return slot;
+}
 
-  obj = createFunctionObject("READI");
-  obj->funcAttrs->returnType = makeIntType();
-  addObject(&(symtab->globalObjectList), obj);
+// Only the first object of a name is indexed, as findObject() would find it
+static void indexObject(Scope *scope, Object *obj) {
+  int slot = indexSlot(scope, obj->nameId);
 
-  obj = createProcedureObject("WRITEI");
-  param = createParameterObject("i", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeIntType();
-  addObject(&(obj->procAttrs->paramList),param);
-  addObject(&(symtab->globalObjectList), obj);
+  if (scope->index[slot] == NULL)
+    scope->index[slot] = obj;
+}
 
-  obj = createProcedureObject("WRITEC");
-  param = createParameterObject("ch", PARAM_VALUE, obj);
-  param->paramAttrs->type = makeCharType();
-  addObject(&(obj->procAttrs->paramList),param);
-  addObject(&(symtab->globalObjectList), obj);
+static void growIndex(KplCompiler *compiler, Scope *scope) {
+  ObjectNode *node;
 
-  obj = createProcedureObject("WRITELN");
-  addObject(&(symtab->globalObjectList), obj);
+  // Old tables stay in the arena; together they are smaller than the new one
+  scope->indexCapacity = (scope->indexCapacity == 0) ? 4 * MIN_INDEXED_SCOPE : scope->indexCapacity * 2;
+  scope->index = (Object**) arenaAlloc(&compiler->arena, scope->indexCapacity * sizeof(Object*));
+  memset(scope->index, 0, scope->indexCapacity * sizeof(Object*));
+  for (node = scope->objList; node != NULL; node = node->next)
+    indexObject(scope, node->object);
+}
 
-  intType = makeIntType();
-  charType = makeCharType();
+void addScopeObject(KplCompiler *compiler, Scope *scope, Object *obj) {
+  ObjectNode* node = (ObjectNode*) arenaAlloc(&compiler->arena, sizeof(ObjectNode));
+  node->object = obj;
+  node->next = NULL;
+  if (scope->objTail == NULL)
+    scope->objList = node;
+  else scope->objTail->next = node;
+  scope->objTail = node;
+  scope->objCount ++;
+
+  if (2 * scope->objCount > scope->indexCapacity) {
+    if (scope->objCount >= MIN_INDEXED_SCOPE)
+      growIndex(compiler, scope);
+  } else indexObject(scope, obj);
 }
 
-void cleanSymTab(void) {
-  freeObject(symtab->program);
-  freeObjectList(symtab->globalObjectList);
-  free(symtab);
-  freeType(intType);
-  freeType(charType);
+Object* findScopeObject(Scope *scope, int nameId) {
+  if (scope->index == NULL)
+    return findObject(scope->objList, nameId);
+  return scope->index[indexSlot(scope, nameId)];
 }
 
-void enterBlock(Scope* scope) {
-  symtab->currentScope = scope;
+/******************* others ******************************/
+
+// Takes the next size words of the scope's frame
+static int allocateFrame(Scope* scope, int size) {
+  int offset = scope->frameSize;
+  scope->frameSize += size;
+  return offset;
 }
 
-void exitBlock(void) {
-  symtab->currentScope = symtab->currentScope->outer;
+static int parameterSize(Object* param) {
+  return (param->paramAttrs.kind == PARAM_REFERENCE) ? REFERENCE_SIZE : sizeOfType(param->paramAttrs.type);
 }
 
-void declareObject(Object* obj) {
+void initSymTab(KplCompiler *compiler) {
+  Object* obj;
+  Object* param;
+
+  compiler->symtab = (SymTab*) arenaAlloc(&compiler->arena, sizeof(SymTab));
+  compiler->symtab->globalObjectList = NULL;
+  compiler->symtab->currentScope = NULL;
+  compiler->symtab->arrayTypes = NULL;
+  compiler->symtab->arrayTypeCount = 0;
+  compiler->symtab->arrayTypeCapacity = 0;
+  compiler->intType = newType(compiler, TP_INT);
+  compiler->charType = newType(compiler, TP_CHAR);
+  
+  obj = createFunctionObject(compiler, internString(&compiler->internTable, "READC"));
+  obj->funcAttrs.returnType = makeCharType(compiler);
+  addObject(compiler, &(compiler->symtab->globalObjectList), obj);
+
+  obj = createFunctionObject(compiler, internString(&compiler->internTable, "READI"));
+  obj->funcAttrs.returnType = makeIntType(compiler);
+  addObject(compiler, &(compiler->symtab->globalObjectList), obj);
+
+  obj = createProcedureObject(compiler, internString(&compiler->internTable, "WRITEI"));
+  param = createParameterObject(compiler, internString(&compiler->internTable, "i"), PARAM_VALUE, obj);
+  param->paramAttrs.type = makeIntType(compiler);
+  param->paramAttrs.localOffset = allocateFrame(obj->procAttrs.scope, parameterSize(param));
+  addObject(compiler, &(obj->procAttrs.paramList),param);
+  addObject(compiler, &(compiler->symtab->globalObjectList), obj);
+
+  obj = createProcedureObject(compiler, internString(&compiler->internTable, "WRITEC"));
+  param = createParameterObject(compiler, internString(&compiler->internTable, "ch"), PARAM_VALUE, obj);
+  param->paramAttrs.type = makeCharType(compiler);
+  param->paramAttrs.localOffset = allocateFrame(obj->procAttrs.scope, parameterSize(param));
+  addObject(compiler, &(obj->procAttrs.paramList),param);
+  addObject(compiler, &(compiler->symtab->globalObjectList), obj);
+
+  obj = createProcedureObject(compiler, internString(&compiler->internTable, "WRITELN"));
+  addObject(compiler, &(compiler->symtab->globalObjectList), obj);
+}
+
+// Everything the symbol table holds came from the compiler's arena
+void cleanSymTab(KplCompiler *compiler) {
+  resetArena(&compiler->arena);
+  compiler->symtab = NULL;
+  compiler->intType = NULL;
+  compiler->charType = NULL;
+}
+
+void enterBlock(KplCompiler *compiler, Scope* scope) {
+  compiler->symtab->currentScope = scope;
+}
+
+void exitBlock(KplCompiler *compiler) {
+  compiler->symtab->currentScope = compiler->symtab->currentScope->outer;
+}
+
+void declareObject(KplCompiler *compiler, Object* obj) {
+  Scope* scope = compiler->symtab->currentScope;
+  int size;
+
+  if (obj->kind == OBJ_VARIABLE) {
+    size = sizeOfType(obj->varAttrs.type);
+    // Offsets must fit in an int; a variable past that is reported and takes no room
+    if (size > INT_MAX - scope->frameSize) {
+      error(compiler, ERR_FRAME_TOO_LARGE, compiler->currentToken->offset);
+      size = 0;
+    }
+    obj->varAttrs.localOffset = allocateFrame(scope, size);
+  }
   if (obj->kind == OBJ_PARAMETER) {
-    Object* owner = symtab->currentScope->owner;
+    Object* owner = scope->owner;
+    obj->paramAttrs.localOffset = allocateFrame(scope, parameterSize(obj));
     switch (owner->kind) {
     case OBJ_FUNCTION:
-      addObject(&(owner->funcAttrs->paramList), obj);
+      addObject(compiler, &(owner->funcAttrs.paramList), obj);
       break;
     case OBJ_PROCEDURE:
-      addObject(&(owner->procAttrs->paramList), obj);
+      addObject(compiler, &(owner->procAttrs.paramList), obj);
       break;
     default:
       break;
     }
   }
  
-  addObject(&(symtab->currentScope->objList), obj);
+  addScopeObject(compiler, scope, obj);
 }
 
 
@@ -9,6 +9,15 @@
 
 #include "token.h"
 
+// Every frame starts with the return value, the dynamic link, the return
+// address and the static link; parameters and then variables follow in
+// declaration order. Sizes and offsets are in words.
+#define RESERVED_WORDS 4
+#define RETURN_VALUE_OFFSET 0
+#define INT_SIZE 1
+#define CHAR_SIZE 1
+#define REFERENCE_SIZE 1
+
 enum TypeClass {
   TP_INT,
   TP_CHAR,
@@ -61,6 +70,7 @@ struct ConstantAttributes_ {
 struct VariableAttributes_ {
   Type *type;
   struct Scope_ *scope;
+  int localOffset;
 };
 
 struct TypeAttributes_ {
@@ -86,6 +96,8 @@ struct ParameterAttributes_ {
   enum ParamKind kind;
   Type* type;
   struct Object_ *function;
+  struct Scope_ *scope;
+  int localOffset;
 };
 
 typedef struct ConstantAttributes_ ConstantAttributes;
@@ -96,17 +108,20 @@ typedef struct ProcedureAttributes_ ProcedureAttributes;
 typedef struct ProgramAttributes_ ProgramAttributes;
 typedef struct ParameterAttributes_ ParameterAttributes;
 
+// The attributes live in the object itself, selected by kind, so a lookup
+// reads nameId, kind and the attributes from one allocation
 struct Object_ {
-  char name[MAX_IDENT_LEN];
+  int nameId;
   enum ObjectKind kind;
+  char *name;
   union {
-    ConstantAttributes* constAttrs;
-    VariableAttributes* varAttrs;
-    TypeAttributes* typeAttrs;
-    FunctionAttributes* funcAttrs;
-    ProcedureAttributes* procAttrs;
-    ProgramAttributes* progAttrs;
-    ParameterAttributes* paramAttrs;
+    ConstantAttributes constAttrs;
+    VariableAttributes varAttrs;
+    TypeAttributes typeAttrs;
+    FunctionAttributes funcAttrs;
+    ProcedureAttributes procAttrs;
+    ProgramAttributes progAttrs;
+    ParameterAttributes paramAttrs;
   };
 };
 
@@ -119,10 +134,18 @@ struct ObjectNode_ {
 
 typedef struct ObjectNode_ ObjectNode;
 
+// Objects are kept in declaration order in objList. Once a scope grows past
+// a few objects they are also indexed by nameId in an open-addressing table.
 struct Scope_ {
   ObjectNode *objList;
+  ObjectNode *objTail;
+  int objCount;
+  Object **index;             // NULL slots are free; NULL until indexed
+  int indexCapacity;          // a power of two, at least twice objCount
   Object *owner;
   struct Scope_ *outer;
+  int level;                  // lexical nesting: 0 for the program
+  int frameSize;              // words in a frame of the owner
 };
 
 typedef struct Scope_ Scope;
@@ -131,37 +154,41 @@ struct SymTab_ {
   Object* program;
   Scope* currentScope;
   ObjectNode *globalObjectList;
+  Type **arrayTypes;          // the array types made so far, hashed on (arraySize, elementType)
+  int arrayTypeCount;
+  int arrayTypeCapacity;
 };
 
 typedef struct SymTab_ SymTab;
 
-Type* makeIntType(void);
-Type* makeCharType(void);
-Type* makeArrayType(int arraySize, Type* elementType);
-Type* duplicateType(Type* type);
+Type* makeIntType(KplCompiler *compiler);
+Type* makeCharType(KplCompiler *compiler);
+Type* makeArrayType(KplCompiler *compiler, int arraySize, Type* elementType);
 int compareType(Type* type1, Type* type2);
-void freeType(Type* type);
-
-ConstantValue* makeIntConstant(int i);
-ConstantValue* makeCharConstant(char ch);
-ConstantValue* duplicateConstantValue(ConstantValue* v);
-
-Scope* createScope(Object* owner, Scope* outer);
-
-Object* createProgramObject(char *programName);
-Object* createConstantObject(char *name);
-Object* createTypeObject(char *name);
-Object* createVariableObject(char *name);
-Object* createFunctionObject(char *name);
-Object* createProcedureObject(char *name);
-Object* createParameterObject(char *name, enum ParamKind kind, Object* owner);
-
-Object* findObject(ObjectNode *objList, char *name);
-
-void initSymTab(void);
-void cleanSymTab(void);
-void enterBlock(Scope* scope);
-void exitBlock(void);
-void declareObject(Object* obj);
+int sizeOfType(Type* type);
+
+ConstantValue* makeIntConstant(KplCompiler *compiler, int i);
+ConstantValue* makeCharConstant(KplCompiler *compiler, char ch);
+ConstantValue* duplicateConstantValue(KplCompiler *compiler, ConstantValue* v);
+
+Scope* createScope(KplCompiler *compiler, Object* owner, Scope* outer);
+
+Object* createProgramObject(KplCompiler *compiler, int programNameId);
+Object* createConstantObject(KplCompiler *compiler, int nameId);
+Object* createTypeObject(KplCompiler *compiler, int nameId);
+Object* createVariableObject(KplCompiler *compiler, int nameId);
+Object* createFunctionObject(KplCompiler *compiler, int nameId);
+Object* createProcedureObject(KplCompiler *compiler, int nameId);
+Object* createParameterObject(KplCompiler *compiler, int nameId, enum ParamKind kind, Object* owner);
+
+Object* findObject(ObjectNode *objList, int nameId);
+Object* findScopeObject(Scope *scope, int nameId);
+void addScopeObject(KplCompiler *compiler, Scope *scope, Object *obj);
+
+void initSymTab(KplCompiler *compiler);
+void cleanSymTab(KplCompiler *compiler);
+void enterBlock(KplCompiler *compiler, Scope* scope);
+void exitBlock(KplCompiler *compiler);
+void declareObject(KplCompiler *compiler, Object* obj);
 
 #endif
@@ -0,0 +1,175 @@
+/* Incremental re-lexing test
+ *
+ * Edits KPL text with relexTokenStream() and checks every result against a
+ * full lex of the edited text. A few fixed edits open, close and split
+ * (* *) comments that span lines; then random edits are made to random
+ * fragments built from the same kind of pieces. Exits non-zero on the
+ * first mismatch.
+ *
+ *   make test_relex && ./test_relex [cases]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reader.h"
+#include "intern.h"
+#include "tokenstream.h"
+#include "compiler.h"
+
+#define DEFAULT_CASES 20000
+#define EDITS_PER_CASE 5
+#define MAX_PIECES 200
+#define MAX_TEXT_LEN 4096
+
+typedef struct {
+  const char *text;
+  int offset;
+  int deleted;
+  const char *inserted;
+} Edit;
+
+// Comments that open in one line and close lines later are the hard case
+Edit fixedEdits[] = {
+  {"A := 1;\nB := 2;\nC := 3 (* three *);\nD := 4;", 0, 0, "(*"},
+  {"(* A := 1;\nB := 2;\nC := 3 *) D := 4;", 0, 2, ""},
+  {"A := 1; (* B := 2;\nC := 3; *)\nD := 4;", 27, 2, ""},
+  {"A := 1; (* B := 2;\nC := 3; *)\nD := 4;", 18, 0, " *)"},
+  {"A := 1; (* B := 2;\nC := 3; *)\nD := 4;", 9, 1, ""},
+  {"A := (1);\nB := 2;\n(* C *) D := 3;", 6, 0, "*"},
+  {"A := (1);\nB := 2 * 3;\nC := 4;", 17, 0, "("},
+  {"A := 1;\n(* B *)\n(* C *)\nD := 4;", 13, 3, "\n"},
+  {"X := 'a';\n(* '(*' *)\nY := 2;", 13, 1, "(*"},
+  {"A := 1; (* open\n\nB := 2;\n", 25, 0, "*) C := 3;"}
+};
+
+const char *pieces[] = {
+  " ", "\n", "\t", "   ", "(*", "*)", "*", "(", ")", "(.", ".)", ".",
+  ":=", ":", "<=", "<", "!=", "!", "'a'", "'", "x", "ab", "BEGIN", "12", "#"
+};
+
+int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+
+/******************************************************************/
+
+// Appends up to count random pieces to text
+int makeText(char *text, int length, int count) {
+  const char *piece;
+
+  while (count-- > 0) {
+    piece = pieces[rand() % pieceCount];
+    if (length + (int) strlen(piece) >= MAX_TEXT_LEN)
+      break;
+    strcpy(text + length, piece);
+    length += strlen(piece);
+  }
+  return length;
+}
+
+// Compares stream with a full lex of the reader's input, which it leaves at the end
+int sameAsFullLex(KplCompiler *compiler, TokenStream *stream) {
+  TokenStream full;
+  int i, same;
+
+  initTokenStream(&full);
+  seekInput(compiler, 0);
+  lexTokenStream(compiler, &full);
+  same = (full.count == stream->count);
+  for (i = 0; same && (i < full.count); i++)
+    same = (full.types[i] == stream->types[i]) &&
+           (full.offsets[i] == stream->offsets[i]) &&
+           (full.values[i] == stream->values[i]);
+  freeTokenStream(&full);
+  return same;
+}
+
+/*
+ * Applies edit to the text in compiler, whose tokens are in stream, and
+ * to expected, a plain copy of that text. Returns the tokens relexed, or
+ * -1 if the result is wrong.
+ */
+int checkEdit(KplCompiler *compiler, TokenStream *stream, char *expected, int *length, Edit *edit) {
+  const char *text;
+  int insertedLength = strlen(edit->inserted);
+  int relexed, newLength;
+
+  relexed = relexTokenStream(compiler, stream, edit->offset, edit->deleted, edit->inserted, insertedLength);
+  memmove(expected + edit->offset + insertedLength, expected + edit->offset + edit->deleted,
+          *length - edit->offset - edit->deleted);
+  memcpy(expected + edit->offset, edit->inserted, insertedLength);
+  *length += insertedLength - edit->deleted;
+
+  text = inputText(compiler, &newLength);
+  if ((relexed < 0) || (newLength != *length) || (memcmp(text, expected, *length) != 0))
+    return -1;
+  return sameAsFullLex(compiler, stream) ? relexed : -1;
+}
+
+void report(const char *text, int length, Edit *edit) {
+  printf("mismatch after replacing %d characters at %d with \"%s\", giving:\n%.*s\n",
+         edit->deleted, edit->offset, edit->inserted, length, text);
+}
+
+/******************************************************************/
+
+int main(int argc, char *argv[]) {
+  static char text[2 * MAX_TEXT_LEN];
+  static char inserted[MAX_TEXT_LEN];
+  KplCompiler *compiler = createCompiler();
+  TokenStream stream;
+  Edit edit;
+  int cases = (argc > 1) ? atoi(argv[1]) : DEFAULT_CASES;
+  long relexedTotal = 0, tokenTotal = 0;
+  int length, relexed, i, k;
+
+  for (i = 0; i < (int) (sizeof(fixedEdits) / sizeof(fixedEdits[0])); i++) {
+    length = strlen(fixedEdits[i].text);
+    memcpy(text, fixedEdits[i].text, length);
+    openInputBuffer(compiler, text, length);
+    initTokenStream(&stream);
+    lexTokenStream(compiler, &stream);
+    if (checkEdit(compiler, &stream, text, &length, &fixedEdits[i]) < 0) {
+      report(text, length, &fixedEdits[i]);
+      return 1;
+    }
+    freeTokenStream(&stream);
+    closeInputStream(compiler);
+    resetInternTable(&compiler->internTable);
+  }
+
+  srand(3323);
+  for (i = 0; i < cases; i++) {
+    length = makeText(text, 0, rand() % MAX_PIECES);
+    openInputBuffer(compiler, text, length);
+    initTokenStream(&stream);
+    lexTokenStream(compiler, &stream);
+
+    for (k = 0; k < EDITS_PER_CASE; k++) {
+      edit.offset = rand() % (length + 1);
+      edit.deleted = rand() % (length - edit.offset + 1);
+      if (rand() % 2)
+        edit.deleted %= 4;
+      inserted[makeText(inserted, 0, rand() % 4)] = '\0';
+      edit.inserted = inserted;
+      if (length - edit.deleted + strlen(inserted) >= MAX_TEXT_LEN)
+        continue;
+
+      relexed = checkEdit(compiler, &stream, text, &length, &edit);
+      if (relexed < 0) {
+        report(text, length, &edit);
+        return 1;
+      }
+      relexedTotal += relexed;
+      tokenTotal += stream.count;
+    }
+
+    freeTokenStream(&stream);
+    closeInputStream(compiler);
+    resetInternTable(&compiler->internTable);
+  }
+
+  printf("relex: %d fixed and %d random cases passed, %ld of %ld tokens relexed\n",
+         (int) (sizeof(fixedEdits) / sizeof(fixedEdits[0])), cases, relexedTotal, tokenTotal);
+  freeCompiler(compiler);
+  return 0;
+}
@@ -0,0 +1,13 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+// Seconds on a monotonic clock; only differences between readings mean anything
+double now(void);
+
+#endif
@@ -6,58 +6,69 @@
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <string.h>
 #include "token.h"
+#include "compiler.h"
+
+// Perfect hash on (first char, last char, length): the 20 keywords land in
+// distinct slots, so an identifier needs at most one string compare
+#define KEYWORD_HASH_SIZE 64
+#define KEYWORD_HASH(first, last, length) \
+  ((((first) << 1) + (last) + (length)) & (KEYWORD_HASH_SIZE - 1))
 
 struct {
-  char string[MAX_IDENT_LEN + 1];
+  char *string;
+  int length;
   TokenType tokenType;
-} keywords[KEYWORDS_COUNT] = {
-  {"PROGRAM", KW_PROGRAM},
-  {"CONST", KW_CONST},
-  {"TYPE", KW_TYPE},
-  {"VAR", KW_VAR},
-  {"INTEGER", KW_INTEGER},
-  {"CHAR", KW_CHAR},
-  {"ARRAY", KW_ARRAY},
-  {"OF", KW_OF},
-  {"FUNCTION", KW_FUNCTION},
-  {"PROCEDURE", KW_PROCEDURE},
-  {"BEGIN", KW_BEGIN},
-  {"END", KW_END},
-  {"CALL", KW_CALL},
-  {"IF", KW_IF},
-  {"THEN", KW_THEN},
-  {"ELSE", KW_ELSE},
-  {"WHILE", KW_WHILE},
-  {"DO", KW_DO},
-  {"FOR", KW_FOR},
-  {"TO", KW_TO}
+} keywords[KEYWORD_HASH_SIZE] = {
+  [KEYWORD_HASH('P', 'M', 7)] = {"PROGRAM", 7, KW_PROGRAM},
+  [KEYWORD_HASH('C', 'T', 5)] = {"CONST", 5, KW_CONST},
+  [KEYWORD_HASH('T', 'E', 4)] = {"TYPE", 4, KW_TYPE},
+  [KEYWORD_HASH('V', 'R', 3)] = {"VAR", 3, KW_VAR},
+  [KEYWORD_HASH('I', 'R', 7)] = {"INTEGER", 7, KW_INTEGER},
+  [KEYWORD_HASH('C', 'R', 4)] = {"CHAR", 4, KW_CHAR},
+  [KEYWORD_HASH('A', 'Y', 5)] = {"ARRAY", 5, KW_ARRAY},
+  [KEYWORD_HASH('O', 'F', 2)] = {"OF", 2, KW_OF},
+  [KEYWORD_HASH('F', 'N', 8)] = {"FUNCTION", 8, KW_FUNCTION},
+  [KEYWORD_HASH('P', 'E', 9)] = {"PROCEDURE", 9, KW_PROCEDURE},
+  [KEYWORD_HASH('B', 'N', 5)] = {"BEGIN", 5, KW_BEGIN},
+  [KEYWORD_HASH('E', 'D', 3)] = {"END", 3, KW_END},
+  [KEYWORD_HASH('C', 'L', 4)] = {"CALL", 4, KW_CALL},
+  [KEYWORD_HASH('I', 'F', 2)] = {"IF", 2, KW_IF},
+  [KEYWORD_HASH('T', 'N', 4)] = {"THEN", 4, KW_THEN},
+  [KEYWORD_HASH('E', 'E', 4)] = {"ELSE", 4, KW_ELSE},
+  [KEYWORD_HASH('W', 'E', 5)] = {"WHILE", 5, KW_WHILE},
+  [KEYWORD_HASH('D', 'O', 2)] = {"DO", 2, KW_DO},
+  [KEYWORD_HASH('F', 'R', 3)] = {"FOR", 3, KW_FOR},
+  [KEYWORD_HASH('T', 'O', 2)] = {"TO", 2, KW_TO}
 };
 
-int keywordEq(char *kw, char *string) {
-  while ((*kw != '\0') && (*string != '\0')) {
-    if (*kw != *string) break;
-    kw ++; string ++;
-  }
-  return ((*kw == '\0') && (*string == '\0'));
-}
-
 TokenType checkKeyword(char *string) {
-  int i;
-  for (i = 0; i < KEYWORDS_COUNT; i++)
-    if (keywordEq(keywords[i].string, string)) 
-      return keywords[i].tokenType;
+  int length = strlen(string);
+  int slot = KEYWORD_HASH((unsigned char) string[0], (unsigned char) string[length - 1], length);
+
+  if ((keywords[slot].length == length) && (memcmp(keywords[slot].string, string, length) == 0))
+    return keywords[slot].tokenType;
   return TK_NONE;
 }
 
-Token* makeToken(TokenType tokenType, int lineNo, int colNo) {
-  Token *token = (Token*)malloc(sizeof(Token));
+// Tokens come from the compiler's fixed ring instead of the heap
+Token* makeToken(KplCompiler *compiler, TokenType tokenType, int offset) {
+  Token *token = &compiler->tokenRing[compiler->tokenRingNext];
+  compiler->tokenRingNext = (compiler->tokenRingNext + 1) % TOKEN_RING_SIZE;
   token->tokenType = tokenType;
-  token->lineNo = lineNo;
-  token->colNo = colNo;
+  token->offset = offset;
+  token->value = 0;
   return token;
 }
 
+// Only the newest token can be handed back; older slots are reclaimed when the ring wraps
+void freeToken(KplCompiler *compiler, Token *token) {
+  int newest = (compiler->tokenRingNext + TOKEN_RING_SIZE - 1) % TOKEN_RING_SIZE;
+  if (token == &compiler->tokenRing[newest])
+    compiler->tokenRingNext = newest;
+}
+
 char *tokenToString(TokenType tokenType) {
   switch (tokenType) {
   case TK_NONE: return "None";
@@ -7,7 +7,6 @@
 #ifndef __TOKEN_H__
 #define __TOKEN_H__
 
-#define MAX_IDENT_LEN 15
 #define KEYWORDS_COUNT 20
 
 typedef enum {
@@ -27,14 +26,16 @@ typedef enum {
 } TokenType; 
 
 typedef struct {
-  char string[MAX_IDENT_LEN + 1];
-  int lineNo, colNo;
+  int offset;
   TokenType tokenType;
-  int value;
+  int value;  // number value, char code, or interned id of an identifier
 } Token;
 
+typedef struct KplCompiler_ KplCompiler;
+
 TokenType checkKeyword(char *string);
-Token* makeToken(TokenType tokenType, int lineNo, int colNo);
+Token* makeToken(KplCompiler *compiler, TokenType tokenType, int offset);
+void freeToken(KplCompiler *compiler, Token *token);
 char *tokenToString(TokenType tokenType);
 
 
@@ -0,0 +1,179 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "reader.h"
+#include "intern.h"
+#include "error.h"
+#include "tokencache.h"
+#include "compiler.h"
+
+// Bump whenever the scanner or the file layout changes, so stale caches miss
+#define TOKEN_CACHE_VERSION 2
+#define MAX_PATH_LEN 4096
+
+/*
+ * A .kplt file is the header followed by the stream's three arrays and then
+ * the interned identifiers in id order, each terminated by '\0'. It is
+ * written in host byte order; caches are not meant to move between machines.
+ */
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t sourceLength;
+  uint32_t tokenCount;
+  uint32_t identCount;
+  uint32_t identBytes;
+} TokenCacheHeader;
+
+// Mixes the text eight bytes at a time; the length is part of the key anyway
+uint64_t hashSource(const char *text, int length) {
+  uint64_t hash = 0x9E3779B97F4A7C15ull ^ (uint64_t) length;
+  uint64_t word;
+  int i;
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    memcpy(&word, text + i, 8);
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 32;
+  }
+  word = 0;
+  memcpy(&word, text + i, length - i);
+  hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ull;
+  hash ^= hash >> 29;
+  return hash;
+}
+
+void cachePath(char *path, const char *dir, uint64_t hash) {
+  snprintf(path, MAX_PATH_LEN, "%s/%016llx.kplt", dir, (unsigned long long) hash);
+}
+
+int loadTokenCache(KplCompiler *compiler, const char *dir, TokenStream *stream) {
+  char path[MAX_PATH_LEN];
+  TokenCacheHeader header;
+  struct stat info;
+  const char *text;
+  char *idents, *ident;
+  uint64_t hash;
+  int length;
+  uint32_t i;
+  FILE *f;
+
+  text = inputText(compiler, &length);
+  hash = hashSource(text, length);
+  cachePath(path, dir, hash);
+  if ((internCount(&compiler->internTable) != 0) || ((f = fopen(path, "rb")) == NULL))
+    return 0;
+
+  if ((fread(&header, sizeof(header), 1, f) != 1) ||
+      (memcmp(header.magic, "KPLT", 4) != 0) ||
+      (header.version != TOKEN_CACHE_VERSION) ||
+      (header.sourceHash != hash) ||
+      (header.sourceLength != (uint32_t) length) ||
+      (header.tokenCount == 0) ||
+      (header.tokenCount > (uint32_t) length + 1) ||
+      (fstat(fileno(f), &info) != 0) ||
+      ((uint64_t) info.st_size != sizeof(header) + header.identBytes +
+                                  (uint64_t) header.tokenCount * (sizeof(uint8_t) + 2 * sizeof(uint32_t)))) {
+    fclose(f);
+    return 0;
+  }
+
+  // The counts match the file's size, so they are safe to allocate for
+  idents = (char*) malloc((size_t) header.identBytes + 1);
+  if (idents == NULL) {
+    fclose(f);
+    return 0;
+  }
+  reserveTokenStream(stream, header.tokenCount);
+  if ((fread(stream->types, sizeof(uint8_t), header.tokenCount, f) != header.tokenCount) ||
+      (fread(stream->offsets, sizeof(uint32_t), header.tokenCount, f) != header.tokenCount) ||
+      (fread(stream->values, sizeof(uint32_t), header.tokenCount, f) != header.tokenCount) ||
+      (fread(idents, 1, header.identBytes, f) != header.identBytes)) {
+    free(idents);
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+
+  // A damaged file must not hand the parser a token it cannot handle
+  for (i = 0, ident = idents; ident < idents + header.identBytes; ident ++)
+    if (*ident == '\0')
+      i ++;
+  if (i != header.identCount) {
+    free(idents);
+    return 0;
+  }
+  for (i = 0; i < header.tokenCount; i++)
+    if ((stream->types[i] > SB_RSEL) ||
+        ((stream->types[i] == TK_IDENT) && (stream->values[i] >= header.identCount)) ||
+        ((stream->types[i] == TK_NONE) && (stream->values[i] >= NUM_OF_ERRORS))) {
+      free(idents);
+      return 0;
+    }
+
+  idents[header.identBytes] = '\0';
+  ident = idents;
+  for (i = 0; i < header.identCount; i++) {
+    internString(&compiler->internTable, ident);
+    ident += strlen(ident) + 1;
+  }
+  free(idents);
+  stream->count = header.tokenCount;
+  return 1;
+}
+
+// Written to a temporary name and renamed, so concurrent compiles never see half a file
+void saveTokenCache(KplCompiler *compiler, const char *dir, TokenStream *stream) {
+  char path[MAX_PATH_LEN];
+  char tempPath[MAX_PATH_LEN + 8];
+  TokenCacheHeader header;
+  const char *text;
+  int length;
+  int i, fd;
+  FILE *f;
+
+  text = inputText(compiler, &length);
+  memcpy(header.magic, "KPLT", 4);
+  header.version = TOKEN_CACHE_VERSION;
+  header.sourceHash = hashSource(text, length);
+  header.sourceLength = length;
+  header.tokenCount = stream->count;
+  header.identCount = internCount(&compiler->internTable);
+  header.identBytes = 0;
+  for (i = 0; i < internCount(&compiler->internTable); i++)
+    header.identBytes += strlen(internedString(&compiler->internTable, i)) + 1;
+
+  mkdir(dir, 0777);
+  cachePath(path, dir, header.sourceHash);
+  snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", path);
+  if ((fd = mkstemp(tempPath)) < 0)
+    return;
+  fchmod(fd, 0644);
+  if ((f = fdopen(fd, "wb")) == NULL) {
+    close(fd);
+    remove(tempPath);
+    return;
+  }
+
+  fwrite(&header, sizeof(header), 1, f);
+  fwrite(stream->types, sizeof(uint8_t), stream->count, f);
+  fwrite(stream->offsets, sizeof(uint32_t), stream->count, f);
+  fwrite(stream->values, sizeof(uint32_t), stream->count, f);
+  for (i = 0; i < internCount(&compiler->internTable); i++)
+    fwrite(internedString(&compiler->internTable, i), 1, strlen(internedString(&compiler->internTable, i)) + 1, f);
+
+  if ((ferror(f) | fclose(f)) != 0)
+    remove(tempPath);
+  else if (rename(tempPath, path) != 0)
+    remove(tempPath);
+}
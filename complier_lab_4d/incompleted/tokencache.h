@@ -0,0 +1,19 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TOKENCACHE_H__
+#define __TOKENCACHE_H__
+
+#include "tokenstream.h"
+
+// Token streams of the compiler's input are cached in <dir>/<hash>.kplt,
+// keyed by a hash of the source text. The intern table must hold only the
+// stream's identifiers (empty before a load, just lexed before a save) so
+// that ids come back unchanged.
+int loadTokenCache(KplCompiler *compiler, const char *dir, TokenStream *stream);
+void saveTokenCache(KplCompiler *compiler, const char *dir, TokenStream *stream);
+
+#endif
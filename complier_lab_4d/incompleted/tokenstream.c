@@ -0,0 +1,148 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "reader.h"
+#include "scanner.h"
+#include "tokenstream.h"
+#include "compiler.h"
+
+#define INITIAL_STREAM_CAPACITY 1024
+
+void initTokenStream(TokenStream *stream) {
+  stream->types = NULL;
+  stream->offsets = NULL;
+  stream->values = NULL;
+  stream->count = 0;
+  stream->capacity = 0;
+}
+
+void freeTokenStream(TokenStream *stream) {
+  free(stream->types);
+  free(stream->offsets);
+  free(stream->values);
+  initTokenStream(stream);
+}
+
+void reserveTokenStream(TokenStream *stream, int capacity) {
+  if (capacity <= stream->capacity)
+    return;
+  stream->capacity = capacity;
+  stream->types = (uint8_t*) realloc(stream->types, stream->capacity * sizeof(uint8_t));
+  stream->offsets = (uint32_t*) realloc(stream->offsets, stream->capacity * sizeof(uint32_t));
+  stream->values = (uint32_t*) realloc(stream->values, stream->capacity * sizeof(uint32_t));
+}
+
+void appendToken(TokenStream *stream, Token *token) {
+  if (stream->count == stream->capacity)
+    reserveTokenStream(stream, (stream->capacity == 0) ? INITIAL_STREAM_CAPACITY : stream->capacity * 2);
+  stream->types[stream->count] = token->tokenType;
+  stream->offsets[stream->count] = token->offset;
+  stream->values[stream->count] = token->value;
+  stream->count ++;
+}
+
+// Lexes from the current reader position up to and including TK_EOF
+void lexTokenStream(KplCompiler *compiler, TokenStream *stream) {
+  Token *token;
+
+  do {
+    token = getToken(compiler);
+    appendToken(stream, token);
+  } while (token->tokenType != TK_EOF);
+}
+
+// Index of the last token starting before offset, or -1 if there is none
+static int lastTokenBefore(TokenStream *stream, int offset) {
+  int lo = -1;
+  int hi = stream->count - 1;
+
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if ((int) stream->offsets[mid] < offset)
+      lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+/*
+ * Applies an edit to the reader's input and brings stream, which must hold
+ * the tokens of the text before the edit, up to date. A token depends only
+ * on the text from its own offset onward, so lexing restarts at the last
+ * token before the edit. It stops as soon as it produces a token past the
+ * edit that the old stream has at the same shifted offset. From there on the
+ * old tokens only need their offsets shifted. An edit that opens or closes
+ * a comment simply keeps the lexer going until the comment ends. Returns
+ * the number of tokens lexed, or -1 if the edit is out of range.
+ */
+int relexTokenStream(KplCompiler *compiler, TokenStream *stream, int offset, int deleted, const char *inserted, int insertedLength) {
+  TokenStream fresh;
+  Token *token;
+  int delta = insertedLength - deleted;
+  int editEnd = offset + insertedLength;
+  int first, old, tail, i;
+
+  if (spliceInput(compiler, offset, deleted, inserted, insertedLength) == IO_ERROR)
+    return -1;
+
+  // Without a token before the edit, a comment at the very start may be involved
+  first = lastTokenBefore(stream, offset);
+  if (first < 0) {
+    first = 0;
+    seekInput(compiler, 0);
+  } else seekInput(compiler, stream->offsets[first]);
+  old = first;
+  initTokenStream(&fresh);
+
+  while (1) {
+    token = getToken(compiler);
+    if (token->offset >= editEnd) {
+      while ((old < stream->count) && ((int) stream->offsets[old] + delta < token->offset))
+        old ++;
+      if ((old < stream->count) && ((int) stream->offsets[old] + delta == token->offset) &&
+          (stream->types[old] == token->tokenType))
+        break;
+    }
+    appendToken(&fresh, token);
+    if (token->tokenType == TK_EOF) {
+      old = stream->count;
+      break;
+    }
+  }
+
+  // stream = old[0, first) + fresh + old[old, count) shifted by delta
+  tail = stream->count - old;
+  reserveTokenStream(stream, first + fresh.count + tail);
+  memmove(stream->types + first + fresh.count, stream->types + old, tail * sizeof(uint8_t));
+  memmove(stream->offsets + first + fresh.count, stream->offsets + old, tail * sizeof(uint32_t));
+  memmove(stream->values + first + fresh.count, stream->values + old, tail * sizeof(uint32_t));
+  for (i = first + fresh.count; i < first + fresh.count + tail; i++)
+    stream->offsets[i] += delta;
+  // An edit that changes no token leaves fresh empty, with no arrays at all
+  if (fresh.count > 0) {
+    memcpy(stream->types + first, fresh.types, fresh.count * sizeof(uint8_t));
+    memcpy(stream->offsets + first, fresh.offsets, fresh.count * sizeof(uint32_t));
+    memcpy(stream->values + first, fresh.values, fresh.count * sizeof(uint32_t));
+  }
+  stream->count = first + fresh.count + tail;
+
+  i = fresh.count;
+  freeTokenStream(&fresh);
+  return i;
+}
+
+// Materializes entry index as a Token; reading past the end keeps returning TK_EOF
+Token* streamToken(KplCompiler *compiler, TokenStream *stream, int index) {
+  Token *token;
+
+  if (index >= stream->count)
+    index = stream->count - 1;
+  token = makeToken(compiler, stream->types[index], stream->offsets[index]);
+  token->value = stream->values[index];
+  return token;
+}
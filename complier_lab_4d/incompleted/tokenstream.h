@@ -0,0 +1,31 @@
+/* 
+ * @copyright (c) 2008, Hedspi, Hanoi University of Technology
+ * @author Huu-Duc Nguyen
+ * @version 1.0
+ */
+
+#ifndef __TOKENSTREAM_H__
+#define __TOKENSTREAM_H__
+
+#include <stdint.h>
+#include "token.h"
+
+// The whole input lexed up front, one entry per token in parallel arrays.
+// TK_NONE entries are lexical errors with the ErrorCode in values[].
+typedef struct {
+  uint8_t *types;
+  uint32_t *offsets;
+  uint32_t *values;
+  int count;
+  int capacity;
+} TokenStream;
+
+void initTokenStream(TokenStream *stream);
+void freeTokenStream(TokenStream *stream);
+void reserveTokenStream(TokenStream *stream, int capacity);
+void appendToken(TokenStream *stream, Token *token);
+void lexTokenStream(KplCompiler *compiler, TokenStream *stream);
+int relexTokenStream(KplCompiler *compiler, TokenStream *stream, int offset, int deleted, const char *inserted, int insertedLength);
+Token* streamToken(KplCompiler *compiler, TokenStream *stream, int index);
+
+#endif